@@ -0,0 +1,1146 @@
+//
+// v8bench: benchmark suite for the v8dll export surface
+//
+// Links the wrapper sources directly (no DLL) and drives them only through the
+// exports declared in v8dll.h, the same way the Delphi wrapper does. Results
+// are printed as a table on stderr and as JSON on stdout (or --json <file>).
+//
+// Linux build, against the same V8 headers and static libraries used for
+// v8dll.dll (a v8_monolith build, or the individual v8_* libraries of a node
+// build as described in README.md):
+//   g++ -O2 -std=c++14 -pthread -I<v8> -I<v8>/include -Icpp
+//       bench/v8bench.cpp cpp/v8dll.cpp cpp/v8metrics.cpp -o v8bench
+//       -L<v8 libs> -lv8_monolith -ldl
+// add -DV8DLL_METRICS to all three sources to make --metrics report the
+// per-export counters alongside the results.
+//
+// Usage: v8bench [--filter <substring>] [--json <file>] [--min-time <ms>] [--metrics]
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "v8dll.h"
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef std::u16string ustring;
+
+ustring U(const std::string& s) {
+	return ustring(s.begin(), s.end());
+}
+
+inline const uint16_t* W(const ustring& s) {
+	return (const uint16_t*)s.c_str();
+}
+
+// resident set size of the process
+uint64_t ResidentBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#else
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	unsigned long long size, resident;
+	int fields = fscanf(f, "%llu %llu", &size, &resident);
+	fclose(f);
+	return fields == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+uint64_t NowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+	std::string name;
+	int64_t iterations;
+	double ns_per_op;
+	double min_ns_per_op;
+	double max_ns_per_op;
+	std::string note;
+};
+
+struct Options {
+	std::string filter;
+	std::string json_path;
+	double min_time_ms = 200;
+	bool metrics = false;
+};
+
+Options options;
+std::vector<Result> results;
+
+//
+// State::Measure calibrates the iteration count until one batch takes about
+// min_time / kRepetitions, then times kRepetitions batches and reports the
+// median. Benchmarks do their setup before Measure and teardown after it.
+//
+class State {
+public:
+	static const int kRepetitions = 5;
+
+	explicit State(const std::string& name) : name_(name) {}
+
+	const std::string& name() const { return name_; }
+
+	void SetNote(const std::string& note) { note_ = note; }
+
+	// run(n) must perform n operations
+	void Measure(const std::function<void(int64_t)>& run) {
+		double batch_ns = options.min_time_ms * 1e6 / kRepetitions;
+		int64_t n = 1;
+		for (;;) {
+			uint64_t start = NowNs();
+			run(n);
+			uint64_t elapsed = NowNs() - start;
+			if (elapsed >= batch_ns || n >= (int64_t(1) << 40))
+				break;
+			// grow towards the target, at most 10x per step
+			double factor = elapsed > 0 ? batch_ns * 1.2 / elapsed : 10;
+			n = (int64_t)(n * std::min(std::max(factor, 2.0), 10.0));
+		}
+		MeasureFixed(n, run);
+	}
+
+	// for operations too slow or too large to calibrate, e.g. 10M element copies
+	void MeasureFixed(int64_t n, const std::function<void(int64_t)>& run) {
+		std::vector<double> samples;
+		for (int i = 0; i < kRepetitions; i++) {
+			uint64_t start = NowNs();
+			run(n);
+			samples.push_back((double)(NowNs() - start) / n);
+		}
+		Report(n, samples);
+	}
+
+	// for runs that time themselves to leave setup and teardown out,
+	// sample() performs one operation and returns its duration in ns
+	void MeasureSamples(const std::function<double()>& sample) {
+		std::vector<double> samples;
+		for (int i = 0; i < kRepetitions; i++)
+			samples.push_back(sample());
+		Report(1, samples);
+	}
+
+private:
+	void Report(int64_t n, std::vector<double>& samples) {
+		std::sort(samples.begin(), samples.end());
+		Result r;
+		r.name = name_;
+		r.iterations = n;
+		r.ns_per_op = samples[kRepetitions / 2];
+		r.min_ns_per_op = samples.front();
+		r.max_ns_per_op = samples.back();
+		r.note = note_;
+		results.push_back(r);
+		fprintf(stderr, "%-48s %12lld %14.1f ns/op  (min %.1f, max %.1f)%s%s\n",
+			name_.c_str(), (long long)n, r.ns_per_op, r.min_ns_per_op, r.max_ns_per_op,
+			note_.empty() ? "" : "  ", note_.c_str());
+	}
+
+	std::string name_;
+	std::string note_;
+};
+
+// an operation that failed would otherwise benchmark as a fast no-op
+void Check(bool ok, const std::string& what) {
+	if (!ok) {
+		fprintf(stderr, "check failed: %s\n", what.c_str());
+		exit(1);
+	}
+}
+
+struct Benchmark {
+	std::string name;
+	std::function<void(State&)> body;
+};
+
+std::vector<Benchmark>& Registry() {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+void Register(const std::string& name, const std::function<void(State&)>& body) {
+	Registry().push_back(Benchmark{ name, body });
+}
+
+//
+// an isolate with one context, both entered for the lifetime of the object,
+// mirroring Tv8Engine.Create + Tv8Engine.enter
+//
+class Engine {
+public:
+	Engine() {
+		isolate_ = v8_new_isolate();
+		v8_enter_isolate(isolate_);
+		context_ = v8_new_context(isolate_);
+		v8_enter_context(context_);
+		global_ = v8_global_object(context_);
+	}
+
+	~Engine() {
+		v8_destroy_object(global_);
+		v8_leave_context(context_);
+		v8_destroy_context(context_);
+		v8_leave_isolate(isolate_);
+		v8_destroy_isolate(isolate_);
+	}
+
+	V8Isolate isolate() const { return isolate_; }
+	V8Context context() const { return context_; }
+	V8Object global() const { return global_; }
+
+	std::string Eval(const std::string& code) {
+		return Eval(U(code));
+	}
+
+	std::string Eval(const ustring& code) {
+		V8String result = v8_eval_asstr(isolate_, context_, W(code));
+		std::string s;
+		if (result) {
+			int len;
+			const uint16_t* p = v8_strinfo(result, &len);
+			s.assign(p, p + len);
+			v8_destroy_string(result);
+		}
+		return s;
+	}
+
+	// evaluates "<fn>(n)" so that loops over n run inside JS
+	void Loop(const std::string& fn, int64_t n) {
+		Eval(fn + "(" + std::to_string(n) + ")");
+	}
+
+private:
+	V8Isolate isolate_;
+	V8Context context_;
+	V8Object global_;
+};
+
+//
+// native callbacks
+//
+
+void NativeSumArgs(V8FunctionCallbackInfo info) {
+	int count = v8_FunctionCallbackInfo_arg_count(info);
+	int32_t sum = 0;
+	for (int i = 0; i < count; i++) {
+		int32_t value;
+		if (v8_FunctionCallbackInfo_arg_as_int32(info, i, &value))
+			sum += value;
+	}
+	v8_FunctionCallbackInfo_return_int32(info, sum);
+}
+
+void NativeReturnString(V8FunctionCallbackInfo info) {
+	auto str = (const ustring*)v8_FunctionCallbackInfo_data(info);
+	v8_FunctionCallbackInfo_return_string(info, W(*str));
+}
+
+void NativeMethod(V8FunctionCallbackInfo info) {
+	auto counter = (int64_t*)v8_FunctionCallbackInfo_internal_field(info, 0);
+	if (counter)
+		(*counter)++;
+}
+
+void* NativeConstruct(V8FunctionCallbackInfo, void* data) {
+	return data;
+}
+
+void NativeFinalize(void* instance, void*) {
+	(*(int64_t*)instance)--;
+}
+
+//
+// script generators
+//
+
+// ~bytes of unrelated top-level functions, the shape of a typical bundle
+std::string LargeScript(size_t bytes) {
+	std::string s;
+	s.reserve(bytes + 128);
+	for (int i = 0; s.size() < bytes; i++) {
+		std::string n = std::to_string(i);
+		s += "function f" + n + "(a, b) { var r = a * " + n + " + b; if (r > 1000) { r = r % 97; } return r; }\n";
+	}
+	s += "0;";
+	return s;
+}
+
+// decimal array index as a null-terminated UTF-16 property name
+const uint16_t* IndexKey(int64_t index, uint16_t (&buf)[24]) {
+	uint16_t* p = buf + 23;
+	*p = 0;
+	do {
+		*--p = (uint16_t)('0' + index % 10);
+		index /= 10;
+	} while (index);
+	return p;
+}
+
+std::string SizeName(size_t size) {
+	if (size >= 1024 * 1024 && size % (1024 * 1024) == 0)
+		return std::to_string(size / (1024 * 1024)) + "M";
+	if (size >= 1024 && size % 1024 == 0)
+		return std::to_string(size / 1024) + "K";
+	return std::to_string(size);
+}
+
+// ~bytes of JSON: an array of small records, the shape of typical API payloads
+std::string JsonDocument(size_t bytes) {
+	std::string s;
+	s.reserve(bytes + 256);
+	s += "[";
+	for (int i = 0; s.size() < bytes; i++) {
+		std::string n = std::to_string(i);
+		if (i)
+			s += ",";
+		s += "{\"id\":" + n + ",\"name\":\"item " + n + "\",\"price\":" + n + ".25,"
+			"\"tags\":[\"red\",\"large\"],\"active\":" + (i % 2 ? "true" : "false") + "}";
+	}
+	s += "]";
+	return s;
+}
+
+// a lookup table of int32 entries, scrambled so that it does not compress to a pattern
+int32_t TableEntry(int i) {
+	return (int32_t)(((uint32_t)i * 2654435761u) >> 4);
+}
+
+std::string TableScript(int entries) {
+	std::string s;
+	s.reserve(entries * 11 + 64);
+	s += "var table = new Int32Array([";
+	for (int i = 0; i < entries; i++) {
+		if (i)
+			s += ",";
+		s += std::to_string(TableEntry(i));
+	}
+	s += "]);";
+	return s;
+}
+
+bool WriteTableFile(const std::string& path, int entries) {
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f)
+		return false;
+	std::vector<int32_t> table(entries);
+	for (int i = 0; i < entries; i++)
+		table[i] = TableEntry(i);
+	bool ok = fwrite(table.data(), sizeof(int32_t), entries, f) == (size_t)entries;
+	return fclose(f) == 0 && ok;
+}
+
+// host-side growable buffer for v8_json_stringify
+BOOL GrowVector(V8Buffer* buffer, int capacity) {
+	auto storage = (std::vector<char>*)buffer->user;
+	storage->resize(capacity);
+	buffer->data = storage->data();
+	buffer->capacity = capacity;
+	return TRUE;
+}
+
+BOOL CountBytes(const void*, int size, void* user) {
+	*(int64_t*)user += size;
+	return TRUE;
+}
+
+//
+// suite
+//
+
+void RegisterEvalBenchmarks() {
+	Register("eval/trivial", [](State& state) {
+		Engine engine;
+		ustring code = U("1 + 1");
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++)
+				v8_destroy_string(v8_eval_asstr(engine.isolate(), engine.context(), W(code)));
+		});
+	});
+
+	for (size_t size : { (size_t)100 * 1024, (size_t)1024 * 1024 }) {
+		// identical source every time, served by the isolate's compilation cache
+		Register("eval/large_cached/" + SizeName(size), [size](State& state) {
+			Engine engine;
+			ustring code = U(LargeScript(size));
+			state.SetNote("bytes=" + std::to_string(code.size()));
+			state.Measure([&](int64_t n) {
+				for (int64_t i = 0; i < n; i++)
+					v8_destroy_string(v8_eval_asstr(engine.isolate(), engine.context(), W(code)));
+			});
+		});
+
+		// a unique leading comment defeats the cache so every run parses and compiles
+		Register("eval/large_uncached/" + SizeName(size), [size](State& state) {
+			Engine engine;
+			ustring body = U(LargeScript(size));
+			int64_t serial = 0;
+			state.SetNote("bytes=" + std::to_string(body.size()));
+			state.Measure([&](int64_t n) {
+				for (int64_t i = 0; i < n; i++) {
+					ustring code = U("//" + std::to_string(serial++) + "\n") + body;
+					v8_destroy_string(v8_eval_asstr(engine.isolate(), engine.context(), W(code)));
+				}
+			});
+		});
+	}
+}
+
+void RegisterCallbackBenchmarks() {
+	for (int args = 0; args <= 8; args++) {
+		Register("callback/args_" + std::to_string(args), [args](State& state) {
+			Engine engine;
+			v8_register_native_function(engine.isolate(), engine.context(), "nativeSum", NativeSumArgs, nullptr);
+			std::string list;
+			for (int i = 0; i < args; i++)
+				list += (i ? ", " : "") + std::to_string(i + 1);
+			engine.Eval("function loop(n) { var s = 0; for (var i = 0; i < n; i++) s += nativeSum(" + list + "); return s; }");
+			state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		});
+	}
+
+	// the same loop calling a JS function, to separate the boundary cost
+	Register("callback/js_baseline", [](State& state) {
+		Engine engine;
+		engine.Eval("function jsSum(a, b) { return a + b; }"
+			"function loop(n) { var s = 0; for (var i = 0; i < n; i++) s += jsSum(1, 2); return s; }");
+		state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+	});
+}
+
+void RegisterFieldBenchmarks() {
+	Register("field/int32", [](State& state) {
+		Engine engine;
+		engine.Eval("var o = { a: 42, f: 1.5, s: 'hello', big: 9007199254740991, child: {} };");
+		V8Object o = v8_object_get_object_field(engine.global(), W(U("o")));
+		ustring name = U("a");
+		int64_t sum = 0;
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++)
+				sum += v8_object_get_int32_field(o, W(name), 0);
+		});
+		v8_destroy_object(o);
+	});
+
+	Register("field/float", [](State& state) {
+		Engine engine;
+		engine.Eval("var o = { f: 1.5 };");
+		V8Object o = v8_object_get_object_field(engine.global(), W(U("o")));
+		ustring name = U("f");
+		double value, sum = 0;
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++) {
+				v8_object_get_float_field(o, W(name), &value);
+				sum += value;
+			}
+		});
+		v8_destroy_object(o);
+	});
+
+	Register("field/int64", [](State& state) {
+		Engine engine;
+		engine.Eval("var o = { big: 9007199254740991 };");
+		V8Object o = v8_object_get_object_field(engine.global(), W(U("o")));
+		ustring name = U("big");
+		int64_t value, sum = 0;
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++) {
+				v8_object_get_int64_field(o, W(name), &value);
+				sum += value;
+			}
+		});
+		v8_destroy_object(o);
+	});
+
+	Register("field/object", [](State& state) {
+		Engine engine;
+		engine.Eval("var o = { child: {} };");
+		V8Object o = v8_object_get_object_field(engine.global(), W(U("o")));
+		ustring name = U("child");
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++)
+				v8_destroy_object(v8_object_get_object_field(o, W(name)));
+		});
+		v8_destroy_object(o);
+	});
+}
+
+void RegisterTemplateBenchmarks() {
+	for (int methods : { 0, 1, 8 }) {
+		Register("template/new_object/methods_" + std::to_string(methods), [methods](State& state) {
+			Engine engine;
+			V8ObjectTemplate tmpl = v8_new_object_template(engine.isolate(), 1);
+			for (int i = 0; i < methods; i++)
+				v8_object_template_add_method(engine.isolate(), engine.context(), tmpl,
+					("m" + std::to_string(i)).c_str(), NativeMethod, nullptr);
+			int64_t counter = 0;
+			state.Measure([&](int64_t n) {
+				for (int64_t i = 0; i < n; i++)
+					v8_destroy_object(v8_new_object(engine.isolate(), engine.context(), tmpl, &counter));
+			});
+			v8_destroy_object_template(tmpl);
+		});
+	}
+
+	Register("template/method_call", [](State& state) {
+		Engine engine;
+		V8ObjectTemplate tmpl = v8_new_object_template(engine.isolate(), 1);
+		v8_object_template_add_method(engine.isolate(), engine.context(), tmpl, "m", NativeMethod, nullptr);
+		int64_t counter = 0;
+		V8Object obj = v8_new_object(engine.isolate(), engine.context(), tmpl, &counter);
+		v8_set_object(engine.isolate(), engine.context(), W(U("obj")), nullptr, obj);
+		engine.Eval("function loop(n) { for (var i = 0; i < n; i++) obj.m(); }");
+		state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		v8_destroy_object(obj);
+		v8_destroy_object_template(tmpl);
+	});
+}
+
+// compare with template/*: methods live on one shared prototype instead of
+// being installed on every instance
+void RegisterClassBenchmarks() {
+	for (int weak = 0; weak <= 1; weak++) {
+		Register(std::string("class/new_instance") + (weak ? "_finalized" : "") + "/methods_8", [weak](State& state) {
+			Engine engine;
+			int64_t live = 0;
+			V8Class cls = v8_new_class(engine.isolate(), "Foo", 1, NativeConstruct,
+				weak ? NativeFinalize : nullptr, &live);
+			for (int i = 0; i < 8; i++)
+				v8_class_add_method(cls, ("m" + std::to_string(i)).c_str(), NativeMethod, nullptr);
+			state.Measure([&](int64_t n) {
+				for (int64_t i = 0; i < n; i++)
+					v8_destroy_object(v8_class_new_instance(engine.isolate(), engine.context(), cls, &live));
+			});
+			v8_destroy_class(cls);
+		});
+	}
+
+	Register("class/new_from_js", [](State& state) {
+		Engine engine;
+		int64_t counter = 0;
+		V8Class cls = v8_new_class(engine.isolate(), "Foo", 1, NativeConstruct, nullptr, &counter);
+		v8_class_add_method(cls, "m", NativeMethod, nullptr);
+		v8_class_install(engine.isolate(), engine.context(), cls);
+		engine.Eval("function loop(n) { var o; for (var i = 0; i < n; i++) o = new Foo(); return o; }");
+		state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		v8_destroy_class(cls);
+	});
+
+	Register("class/method_call", [](State& state) {
+		Engine engine;
+		int64_t counter = 0;
+		V8Class cls = v8_new_class(engine.isolate(), "Foo", 1, NativeConstruct, nullptr, &counter);
+		v8_class_add_method(cls, "m", NativeMethod, nullptr);
+		v8_class_install(engine.isolate(), engine.context(), cls);
+		engine.Eval("var obj = new Foo(); function loop(n) { for (var i = 0; i < n; i++) obj.m(); }");
+		state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		v8_destroy_class(cls);
+	});
+
+	// many receivers at one call site, all sharing a hidden class
+	Register("class/method_call_many_instances", [](State& state) {
+		Engine engine;
+		int64_t counter = 0;
+		V8Class cls = v8_new_class(engine.isolate(), "Foo", 1, NativeConstruct, nullptr, &counter);
+		v8_class_add_method(cls, "m", NativeMethod, nullptr);
+		v8_class_install(engine.isolate(), engine.context(), cls);
+		engine.Eval("var objs = []; for (var i = 0; i < 1024; i++) objs.push(new Foo());"
+			"function loop(n) { for (var i = 0; i < n; i++) objs[i & 1023].m(); }");
+		state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		v8_destroy_class(cls);
+	});
+
+	Register("template/method_call_many_instances", [](State& state) {
+		Engine engine;
+		V8ObjectTemplate tmpl = v8_new_object_template(engine.isolate(), 1);
+		v8_object_template_add_method(engine.isolate(), engine.context(), tmpl, "m", NativeMethod, nullptr);
+		int64_t counter = 0;
+		V8Object arr = v8_new_array_from_values(engine.isolate(), engine.context(), nullptr, 0);
+		v8_set_object(engine.isolate(), engine.context(), W(U("objs")), nullptr, arr);
+		for (int i = 0; i < 1024; i++) {
+			V8Object obj = v8_new_object(engine.isolate(), engine.context(), tmpl, &counter);
+			v8_set_object(engine.isolate(), engine.context(), W(U("o")), nullptr, obj);
+			engine.Eval("objs.push(o);");
+			v8_destroy_object(obj);
+		}
+		engine.Eval("function loop(n) { for (var i = 0; i < n; i++) objs[i & 1023].m(); }");
+		state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		v8_destroy_object(arr);
+		v8_destroy_object_template(tmpl);
+	});
+}
+
+void RegisterStringBenchmarks() {
+	for (size_t size : { (size_t)16, (size_t)1024, (size_t)64 * 1024, (size_t)1024 * 1024 }) {
+		// JS -> native: String::Value copy plus the host's own copy
+		Register("string/to_native/" + SizeName(size), [size](State& state) {
+			Engine engine;
+			engine.Eval("var s = 'x'.repeat(" + std::to_string(size) + ");");
+			ustring name = U("s");
+			std::vector<uint16_t> sink(size);
+			state.Measure([&](int64_t n) {
+				for (int64_t i = 0; i < n; i++) {
+					V8String str = v8_object_get_string_field(engine.global(), W(name));
+					int len;
+					const uint16_t* p = v8_strinfo(str, &len);
+					memcpy(sink.data(), p, len * sizeof(uint16_t));
+					v8_destroy_string(str);
+				}
+			});
+		});
+
+		// native -> JS: a callback returning a string of the given size
+		Register("string/from_native/" + SizeName(size), [size](State& state) {
+			Engine engine;
+			ustring payload(size, u'y');
+			v8_register_native_function(engine.isolate(), engine.context(), "nativeString",
+				NativeReturnString, &payload);
+			engine.Eval("function loop(n) { var l = 0; for (var i = 0; i < n; i++) l += nativeString().length; return l; }");
+			state.Measure([&](int64_t n) { engine.Loop("loop", n); });
+		});
+	}
+}
+
+// whole-array reads are measured once per repetition from 1M elements up
+void MeasureArray(State& state, int64_t elements, const std::function<void(int64_t)>& run) {
+	state.SetNote("elements=" + std::to_string(elements));
+	if (elements >= 1000000)
+		state.MeasureFixed(1, run);
+	else
+		state.Measure(run);
+}
+
+void RegisterArrayBenchmarks() {
+	for (int64_t count : { (int64_t)1000, (int64_t)100000, (int64_t)10000000 }) {
+		std::string suffix = "/" + std::to_string(count);
+		std::string fill_int = "var a = []; for (var i = 0; i < " + std::to_string(count) + "; i++) a.push(i);";
+		std::string fill_float = "var a = []; for (var i = 0; i < " + std::to_string(count) + "; i++) a.push(i + 0.5);";
+		std::string fill_typed = "var a = new Int32Array(" + std::to_string(count) + "); for (var i = 0; i < a.length; i++) a[i] = i;";
+
+		// what hosts do today: one getter per element with a stringified index
+		Register("array/read_per_index_int32" + suffix, [count, fill_int](State& state) {
+			Engine engine;
+			engine.Eval(fill_int);
+			V8Object a = v8_object_get_object_field(engine.global(), W(U("a")));
+			int64_t sum = 0;
+			uint16_t key[24];
+			MeasureArray(state, count, [&](int64_t n) {
+				for (int64_t j = 0; j < n; j++)
+					for (int64_t i = 0; i < count; i++)
+						sum += v8_object_get_int32_field(a, IndexKey(i, key), 0);
+			});
+			v8_destroy_object(a);
+		});
+
+		Register("array/read_bulk_int32" + suffix, [count, fill_int](State& state) {
+			Engine engine;
+			engine.Eval(fill_int);
+			V8Object a = v8_object_get_object_field(engine.global(), W(U("a")));
+			std::vector<int32_t> buffer(count);
+			int copied = 0;
+			MeasureArray(state, count, [&](int64_t n) {
+				for (int64_t j = 0; j < n; j++)
+					copied = v8_array_get_int32(a, 0, buffer.data(), (int)count);
+			});
+			Check(copied == count && buffer[count - 1] == (int32_t)(count - 1), state.name());
+			v8_destroy_object(a);
+		});
+
+		Register("array/read_per_index_float" + suffix, [count, fill_float](State& state) {
+			Engine engine;
+			engine.Eval(fill_float);
+			V8Object a = v8_object_get_object_field(engine.global(), W(U("a")));
+			double value, sum = 0;
+			uint16_t key[24];
+			MeasureArray(state, count, [&](int64_t n) {
+				for (int64_t j = 0; j < n; j++)
+					for (int64_t i = 0; i < count; i++) {
+						v8_object_get_float_field(a, IndexKey(i, key), &value);
+						sum += value;
+					}
+			});
+			v8_destroy_object(a);
+		});
+
+		Register("array/read_bulk_float" + suffix, [count, fill_float](State& state) {
+			Engine engine;
+			engine.Eval(fill_float);
+			V8Object a = v8_object_get_object_field(engine.global(), W(U("a")));
+			std::vector<double> buffer(count);
+			int copied = 0;
+			MeasureArray(state, count, [&](int64_t n) {
+				for (int64_t j = 0; j < n; j++)
+					copied = v8_array_get_float(a, 0, buffer.data(), (int)count);
+			});
+			Check(copied == count && buffer[count - 1] == (double)((count - 1) + 0.5), state.name());
+			v8_destroy_object(a);
+		});
+
+		Register("array/read_bulk_typed_int32" + suffix, [count, fill_typed](State& state) {
+			Engine engine;
+			engine.Eval(fill_typed);
+			V8Object a = v8_object_get_object_field(engine.global(), W(U("a")));
+			std::vector<int32_t> buffer(count);
+			int copied = 0;
+			MeasureArray(state, count, [&](int64_t n) {
+				for (int64_t j = 0; j < n; j++)
+					copied = v8_array_get_int32(a, 0, buffer.data(), (int)count);
+			});
+			Check(copied == count && buffer[count - 1] == (int32_t)(count - 1), state.name());
+			v8_destroy_object(a);
+		});
+
+		for (int typed = 0; typed <= 1; typed++) {
+			Register(std::string(typed ? "array/create_typed_int32" : "array/create_int32") + suffix,
+				[count, typed](State& state) {
+				Engine engine;
+				std::vector<int32_t> data(count);
+				for (int64_t i = 0; i < count; i++)
+					data[i] = (int32_t)i;
+				MeasureArray(state, count, [&](int64_t n) {
+					for (int64_t j = 0; j < n; j++)
+						v8_destroy_object(v8_new_int32_array(engine.isolate(), engine.context(),
+							data.data(), (int)count, typed));
+				});
+			});
+		}
+	}
+}
+
+// documents of 1M and up are measured once per repetition
+void MeasureDocument(State& state, size_t bytes, const std::function<void(int64_t)>& run) {
+	state.SetNote("bytes=" + std::to_string(bytes));
+	if (bytes >= 1024 * 1024)
+		state.MeasureFixed(1, run);
+	else
+		state.Measure(run);
+}
+
+void RegisterJsonBenchmarks() {
+	for (size_t size : { (size_t)1024, (size_t)64 * 1024, (size_t)1024 * 1024,
+		(size_t)10 * 1024 * 1024, (size_t)100 * 1024 * 1024 }) {
+		std::string suffix = "/" + SizeName(size);
+
+		// what hosts do today: splice the document into source text and fetch
+		// the result back, a unique comment keeps the compilation cache out
+		Register("json/parse_eval_concat" + suffix, [size](State& state) {
+			Engine engine;
+			ustring doc = U(JsonDocument(size));
+			ustring name = U("data");
+			int64_t serial = 0;
+			MeasureDocument(state, doc.size(), [&](int64_t n) {
+				for (int64_t i = 0; i < n; i++) {
+					ustring code = U("//" + std::to_string(serial++) + "\nvar data = ") + doc + U(";");
+					v8_destroy_string(v8_eval_asstr(engine.isolate(), engine.context(), W(code)));
+					v8_destroy_object(v8_object_get_object_field(engine.global(), W(name)));
+				}
+			});
+		});
+
+		Register("json/parse_utf16" + suffix, [size](State& state) {
+			Engine engine;
+			ustring doc = U(JsonDocument(size));
+			MeasureDocument(state, doc.size(), [&](int64_t n) {
+				for (int64_t i = 0; i < n; i++) {
+					V8Object parsed = v8_json_parse(engine.isolate(), engine.context(),
+						W(doc), (int)doc.size(), V8_UTF16);
+					Check(parsed != nullptr, state.name());
+					v8_destroy_object(parsed);
+				}
+			});
+		});
+
+		Register("json/parse_utf8" + suffix, [size](State& state) {
+			Engine engine;
+			std::string doc = JsonDocument(size);
+			MeasureDocument(state, doc.size(), [&](int64_t n) {
+				for (int64_t i = 0; i < n; i++) {
+					V8Object parsed = v8_json_parse(engine.isolate(), engine.context(),
+						doc.data(), (int)doc.size(), V8_UTF8);
+					Check(parsed != nullptr, state.name());
+					v8_destroy_object(parsed);
+				}
+			});
+		});
+
+		// JSON.stringify through eval, copied out of the String::Value
+		Register("json/stringify_eval" + suffix, [size](State& state) {
+			Engine engine;
+			std::string doc = JsonDocument(size);
+			V8Object data = v8_json_parse(engine.isolate(), engine.context(), doc.data(), (int)doc.size(), V8_UTF8);
+			Check(data != nullptr, state.name());
+			v8_set_object(engine.isolate(), engine.context(), W(U("data")), engine.global(), data);
+			ustring code = U("JSON.stringify(data)");
+			ustring sink;
+			MeasureDocument(state, doc.size(), [&](int64_t n) {
+				for (int64_t i = 0; i < n; i++) {
+					V8String str = v8_eval_asstr(engine.isolate(), engine.context(), W(code));
+					int len;
+					const uint16_t* p = v8_strinfo(str, &len);
+					sink.assign((const char16_t*)p, len);
+					v8_destroy_string(str);
+				}
+			});
+			v8_destroy_object(data);
+		});
+
+		// straight into a reused host buffer
+		Register("json/stringify_buffer_utf8" + suffix, [size](State& state) {
+			Engine engine;
+			std::string doc = JsonDocument(size);
+			V8Object data = v8_json_parse(engine.isolate(), engine.context(), doc.data(), (int)doc.size(), V8_UTF8);
+			Check(data != nullptr, state.name());
+			std::vector<char> storage;
+			V8Buffer buffer = { nullptr, 0, 0, GrowVector, &storage };
+			MeasureDocument(state, doc.size(), [&](int64_t n) {
+				for (int64_t i = 0; i < n; i++)
+					Check(v8_json_stringify(data, nullptr, V8_UTF8, &buffer) >= 0, state.name());
+			});
+			v8_destroy_object(data);
+		});
+
+		Register("json/write_stream_utf8" + suffix, [size](State& state) {
+			Engine engine;
+			std::string doc = JsonDocument(size);
+			V8Object data = v8_json_parse(engine.isolate(), engine.context(), doc.data(), (int)doc.size(), V8_UTF8);
+			Check(data != nullptr, state.name());
+			int64_t written = 0;
+			MeasureDocument(state, doc.size(), [&](int64_t n) {
+				for (int64_t i = 0; i < n; i++)
+					Check(v8_json_write(data, V8_UTF8, CountBytes, &written) >= 0, state.name());
+			});
+			v8_destroy_object(data);
+		});
+	}
+}
+
+// per sample: creates the engines and loads the table into each (only the loads
+// are timed); the note reports the largest RSS growth of a sample
+void MeasureLoad(State& state, int isolates, const std::function<void(Engine&)>& load) {
+	uint64_t peak_growth = 0;
+	state.MeasureSamples([&]() {
+		uint64_t before = ResidentBytes();
+		uint64_t elapsed = 0;
+		std::vector<Engine*> engines;
+		for (int i = 0; i < isolates; i++) {
+			// an Engine enters its isolate, the one just created is the current one
+			engines.push_back(new Engine());
+			uint64_t start = NowNs();
+			load(*engines.back());
+			elapsed += NowNs() - start;
+		}
+		uint64_t after = ResidentBytes();
+		peak_growth = std::max(peak_growth, after > before ? after - before : 0);
+		state.SetNote("isolates=" + std::to_string(isolates) + " rss_growth_mb=" +
+			std::to_string(peak_growth / (1024 * 1024)));
+		// isolates are left in the reverse order of entering
+		while (!engines.empty()) {
+			delete engines.back();
+			engines.pop_back();
+		}
+		return (double)elapsed;
+	});
+}
+
+void RegisterSharedBenchmarks() {
+	// 4MB of int32, one entry read per 4KB page pulls the whole table in
+	const int kEntries = 1024 * 1024;
+	const std::string touch = "var s = 0; for (var i = 0; i < table.length; i += 1024) s += table[i]; s";
+
+	for (int isolates : { 1, 8, 32 }) {
+		std::string suffix = "/" + std::to_string(isolates);
+
+		// bare engines, the RSS baseline for the two below
+		Register("shared/load_none" + suffix, [=](State& state) {
+			MeasureLoad(state, isolates, [&](Engine&) {});
+		});
+
+		// what hosts do today: every engine evaluates its own copy
+		Register("shared/load_eval" + suffix, [=](State& state) {
+			ustring code = U(TableScript(kEntries));
+			MeasureLoad(state, isolates, [&](Engine& engine) {
+				engine.Eval(code);
+				engine.Eval(touch);
+			});
+		});
+
+		Register("shared/load_mapped" + suffix, [=](State& state) {
+			std::string path = "v8bench_table.bin";
+			if (!WriteTableFile(path, kEntries)) {
+				fprintf(stderr, "cannot write %s\n", path.c_str());
+				return;
+			}
+			V8SharedRegion region = v8_map_file(W(U(path)), FALSE);
+			if (!region) {
+				fprintf(stderr, "cannot map %s, skipping %s\n", path.c_str(), state.name().c_str());
+				remove(path.c_str());
+				return;
+			}
+
+			// a view that cannot be created (e.g. no SharedArrayBuffer) skips the suite
+			{
+				Engine engine;
+				V8Object view = v8_shared_region_view(engine.isolate(), engine.context(), region, 0, -1, V8_VIEW_INT32);
+				if (!view) {
+					fprintf(stderr, "cannot create a shared view, skipping %s\n", state.name().c_str());
+					v8_destroy_shared_region(region);
+					remove(path.c_str());
+					return;
+				}
+				v8_destroy_object(view);
+			}
+
+			ustring name = U("table");
+			MeasureLoad(state, isolates, [&](Engine& engine) {
+				V8Object view = v8_shared_region_view(engine.isolate(), engine.context(), region, 0, -1, V8_VIEW_INT32);
+				Check(view != nullptr, state.name());
+				v8_set_object(engine.isolate(), engine.context(), W(name), engine.global(), view);
+				v8_destroy_object(view);
+				engine.Eval(touch);
+			});
+			v8_destroy_shared_region(region);
+			remove(path.c_str());
+		});
+	}
+}
+
+// waits until bytes of a bundle arriving at mb_per_s since start are available,
+// due times are absolute so an oversleep is caught up on the next chunk
+void Arrive(uint64_t start, size_t bytes, double mb_per_s) {
+	if (mb_per_s <= 0)
+		return;
+	uint64_t due = start + (uint64_t)(bytes / (mb_per_s * 1024 * 1024) * 1e9);
+	uint64_t now = NowNs();
+	if (now < due)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+}
+
+void RegisterStreamBenchmarks() {
+	const size_t kBundle = 20 * 1024 * 1024;
+	const size_t kChunk = 64 * 1024;
+
+	// time to first execution: from the first chunk arriving until the
+	// script's top level has run; 0 = chunks are all there, else disk/network
+	// speed in MB/s. A unique leading comment keeps the compilation cache out
+	for (double mb_per_s : { 0.0, 100.0 }) {
+		std::string suffix = "/" + SizeName(kBundle) + (mb_per_s > 0 ? "@" + std::to_string((int)mb_per_s) + "MBps" : "");
+
+		// what hosts do today: collect the whole bundle, then compile it
+		Register("stream/monolithic_utf16" + suffix, [=](State& state) {
+			ustring body = U(LargeScript(kBundle));
+			int64_t serial = 0;
+			state.SetNote("bytes=" + std::to_string(body.size()));
+			state.MeasureSamples([&]() {
+				Engine engine;
+				ustring bundle = U("//" + std::to_string(serial++) + "\n") + body;
+				uint64_t start = NowNs();
+				ustring code;
+				for (size_t offset = 0; offset < bundle.size(); offset += kChunk) {
+					size_t size = std::min(kChunk, bundle.size() - offset);
+					Arrive(start, (offset + size) * sizeof(uint16_t), mb_per_s);
+					code.append(bundle, offset, size);
+				}
+				v8_destroy_string(v8_eval_asstr(engine.isolate(), engine.context(), W(code)));
+				return (double)(NowNs() - start);
+			});
+		});
+
+		Register("stream/streamed_utf16" + suffix, [=](State& state) {
+			ustring body = U(LargeScript(kBundle));
+			int64_t serial = 0;
+			state.SetNote("bytes=" + std::to_string(body.size()));
+			state.MeasureSamples([&]() {
+				Engine engine;
+				ustring bundle = U("//" + std::to_string(serial++) + "\n") + body;
+				uint64_t start = NowNs();
+				V8ScriptStream stream = v8_new_script_stream(engine.isolate(), V8_UTF16, W(U("bundle.js")));
+				Check(stream != nullptr, state.name());
+				for (size_t offset = 0; offset < bundle.size(); offset += kChunk) {
+					size_t size = std::min(kChunk, bundle.size() - offset);
+					Arrive(start, (offset + size) * sizeof(uint16_t), mb_per_s);
+					Check(v8_script_stream_feed(stream, bundle.data() + offset, (int)size) != FALSE, state.name());
+				}
+				V8String result = v8_script_stream_run(stream, engine.context());
+				Check(result != nullptr, state.name());
+				v8_destroy_string(result);
+				double elapsed = (double)(NowNs() - start);
+				v8_destroy_script_stream(stream);
+				return elapsed;
+			});
+		});
+
+		// UTF-8 is what bundles are stored as, and half the bytes to move
+		Register("stream/streamed_utf8" + suffix, [=](State& state) {
+			std::string body = LargeScript(kBundle);
+			int64_t serial = 0;
+			state.SetNote("bytes=" + std::to_string(body.size()));
+			state.MeasureSamples([&]() {
+				Engine engine;
+				std::string bundle = "//" + std::to_string(serial++) + "\n" + body;
+				uint64_t start = NowNs();
+				V8ScriptStream stream = v8_new_script_stream(engine.isolate(), V8_UTF8, W(U("bundle.js")));
+				Check(stream != nullptr, state.name());
+				for (size_t offset = 0; offset < bundle.size(); offset += kChunk) {
+					size_t size = std::min(kChunk, bundle.size() - offset);
+					Arrive(start, offset + size, mb_per_s);
+					Check(v8_script_stream_feed(stream, bundle.data() + offset, (int)size) != FALSE, state.name());
+				}
+				V8String result = v8_script_stream_run(stream, engine.context());
+				Check(result != nullptr, state.name());
+				v8_destroy_string(result);
+				double elapsed = (double)(NowNs() - start);
+				v8_destroy_script_stream(stream);
+				return elapsed;
+			});
+		});
+	}
+}
+
+void RegisterLifecycleBenchmarks() {
+	Register("lifecycle/isolate_and_context", [](State& state) {
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++) {
+				Engine engine;
+			}
+		});
+	});
+
+	Register("lifecycle/context", [](State& state) {
+		Engine engine;
+		state.Measure([&](int64_t n) {
+			for (int64_t i = 0; i < n; i++)
+				v8_destroy_context(v8_new_context(engine.isolate()));
+		});
+	});
+}
+
+//
+// output
+//
+
+std::string JsonEscape(const std::string& s) {
+	std::string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+void WriteJson(FILE* f, const std::string& metrics) {
+	fprintf(f, "{\"suite\":\"v8dll\",\"min_time_ms\":%g,\"results\":[", options.min_time_ms);
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		fprintf(f, "%s\n{\"name\":\"%s\",\"iterations\":%lld,\"ns_per_op\":%.3f,\"min_ns_per_op\":%.3f,\"max_ns_per_op\":%.3f",
+			i ? "," : "", JsonEscape(r.name).c_str(), (long long)r.iterations,
+			r.ns_per_op, r.min_ns_per_op, r.max_ns_per_op);
+		if (!r.note.empty())
+			fprintf(f, ",\"note\":\"%s\"", JsonEscape(r.note).c_str());
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n]");
+	if (!metrics.empty())
+		fprintf(f, ",\"metrics\":%s", metrics.c_str());
+	fprintf(f, "}\n");
+}
+
+bool ParseArgs(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc)
+			options.filter = argv[++i];
+		else if (arg == "--json" && i + 1 < argc)
+			options.json_path = argv[++i];
+		else if (arg == "--min-time" && i + 1 < argc)
+			options.min_time_ms = atof(argv[++i]);
+		else if (arg == "--metrics")
+			options.metrics = true;
+		else {
+			fprintf(stderr, "usage: %s [--filter <substring>] [--json <file>] [--min-time <ms>] [--metrics]\n", argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (!ParseArgs(argc, argv))
+		return 2;
+
+	if (!v8_init()) {
+		fprintf(stderr, "v8_init failed\n");
+		return 1;
+	}
+
+	if (options.metrics && !v8_enable_metrics(TRUE) && v8_get_metrics(nullptr, 0) == 0)
+		fprintf(stderr, "metrics requested but v8dll was built without V8DLL_METRICS\n");
+
+	RegisterEvalBenchmarks();
+	RegisterCallbackBenchmarks();
+	RegisterFieldBenchmarks();
+	RegisterTemplateBenchmarks();
+	RegisterClassBenchmarks();
+	RegisterStringBenchmarks();
+	RegisterArrayBenchmarks();
+	RegisterJsonBenchmarks();
+	RegisterSharedBenchmarks();
+	RegisterStreamBenchmarks();
+	RegisterLifecycleBenchmarks();
+
+	for (Benchmark& benchmark : Registry()) {
+		if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+			continue;
+		State state(benchmark.name);
+		benchmark.body(state);
+	}
+
+	std::string metrics;
+	if (options.metrics) {
+		int len = v8_get_metrics(nullptr, 0);
+		if (len > 0) {
+			metrics.resize(len + 1);
+			len = v8_get_metrics(&metrics[0], len + 1);
+			metrics.resize(len);
+		}
+	}
+
+	if (options.json_path.empty())
+		WriteJson(stdout, metrics);
+	else {
+		FILE* f = fopen(options.json_path.c_str(), "w");
+		if (!f) {
+			fprintf(stderr, "cannot write %s\n", options.json_path.c_str());
+			return 1;
+		}
+		WriteJson(f, metrics);
+		fclose(f);
+	}
+
+	v8_cleanup();
+	return 0;
+}
@@ -3,8 +3,35 @@
 #include "targetver.h"
 #include <assert.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <include/v8.h>
 #include <include/libplatform/libplatform.h>
+#include <include/v8-profiler.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// one diagnostic per line on stderr, so that they do not run together or into
+// a host's own output
+inline void OutputDebugStringA(const char* s) {
+	size_t len = strlen(s);
+	fputs(s, stderr);
+	if (len == 0 || s[len - 1] != '\n')
+		fputc('\n', stderr);
+}
+#endif
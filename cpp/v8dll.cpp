@@ -1,13 +1,27 @@
 #include "stdafx.h"
 #include "v8dll.h"
+#include "v8metrics.h"
+#include "v8inspector.h"
 
 using namespace v8;
 
-#define LocalStringFromUtf8(isolate, s) (String::NewFromUtf8(isolate, s, NewStringType::kNormal).ToLocalChecked())
-#define LocalString(isolate, s) (String::NewFromTwoByte(isolate, (const uint16_t*)s, NewStringType::kNormal).ToLocalChecked())
+#define LocalStringFromUtf8(isolate, s) (CountInputString(String::NewFromUtf8(isolate, s, NewStringType::kNormal).ToLocalChecked()))
+#define LocalString(isolate, s) (CountInputString(String::NewFromTwoByte(isolate, (const uint16_t*)s, NewStringType::kNormal).ToLocalChecked()))
 
 Platform* v8Platform;
 
+inline Local<String> CountInputString(Local<String> str) {
+	V8_COUNT_STRING_BYTES(str->Length() * sizeof(uint16_t));
+	return str;
+}
+
+// every handle handed out to the host goes through here
+template <class T>
+inline Global<T>* NewGlobalHandle(Isolate* isolate, Local<T> handle) {
+	V8_COUNT_HANDLES(1);
+	return new Global<T>(isolate, handle);
+}
+
 class SimpleArrayBufferAllocator : public ArrayBuffer::Allocator {
 public:
 	virtual void* Allocate(size_t length) {
@@ -20,7 +34,11 @@ public:
 
 SimpleArrayBufferAllocator array_buffer_allocator;
 
+static void FreeRetiredClasses(Isolate* isolate);
+static void CacheContextBuiltins(Isolate* isolate, Local<Context> context);
+
 BOOL __stdcall v8_init() {
+	V8_EXPORT_SCOPE(v8_init);
 	if (!V8::InitializeICU())
 		return FALSE;
 
@@ -49,6 +67,7 @@ BOOL __stdcall v8_init() {
 }
 
 void __stdcall v8_cleanup() {
+	V8_EXPORT_SCOPE(v8_cleanup);
 	V8::Dispose();
 	V8::ShutdownPlatform();
 	delete v8Platform;
@@ -56,25 +75,37 @@ void __stdcall v8_cleanup() {
 }
 
 V8Isolate __stdcall v8_new_isolate() {
+	V8_EXPORT_SCOPE(v8_new_isolate);
 	Isolate::CreateParams create_params;
 	create_params.array_buffer_allocator = &array_buffer_allocator;
 	return (V8Isolate)Isolate::New(create_params);
 }
 
 void __stdcall v8_destroy_isolate(V8Isolate isolate) {
+	V8_EXPORT_SCOPE(v8_destroy_isolate);
+#ifdef V8DLL_INSPECTOR
+	{
+		Isolate::Scope isolate_scope((Isolate*)isolate);
+		v8dll_inspector::Stop((Isolate*)isolate);
+	}
+#endif
 	((Isolate*)isolate)->Dispose();
+	FreeRetiredClasses((Isolate*)isolate);
 }
 
 void __stdcall v8_enter_isolate(V8Isolate isolate) {
+	V8_EXPORT_SCOPE(v8_enter_isolate);
 	((Isolate*)isolate)->Enter();
 }
 
 void __stdcall v8_leave_isolate(V8Isolate isolate) {
+	V8_EXPORT_SCOPE(v8_leave_isolate);
 	((Isolate*)isolate)->Exit();
 }
 
 void __stdcall v8_throw_exception(int type, const uint16_t* errmsg)
 {
+	V8_EXPORT_SCOPE(v8_throw_exception);
 	Isolate* isolate = Isolate::GetCurrent();
 	HandleScope scope(isolate);
 	switch (type) {
@@ -101,13 +132,16 @@ void __stdcall v8_throw_exception(int type, const uint16_t* errmsg)
 }
 
 V8Context __stdcall v8_new_context(V8Isolate _isolate) {
+	V8_EXPORT_SCOPE(v8_new_context);
 	Isolate* isolate = (Isolate*)_isolate;
 	HandleScope handle_scope(isolate);
 	Local<Context> context = Context::New(isolate);
-	return new Global<Context>(isolate, context);
+	CacheContextBuiltins(isolate, context);
+	return NewGlobalHandle(isolate, context);
 }
 
 void __stdcall v8_enter_context(V8Context _context) {
+	V8_EXPORT_SCOPE(v8_enter_context);
 	auto context = (Global<Context>*)_context;
 	auto isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -116,6 +150,7 @@ void __stdcall v8_enter_context(V8Context _context) {
 }
 
 void __stdcall v8_leave_context(V8Context _context) {
+	V8_EXPORT_SCOPE(v8_leave_context);
 	auto context = (Global<Context>*)_context;
 	auto isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -125,19 +160,22 @@ void __stdcall v8_leave_context(V8Context _context) {
 
 
 void __stdcall v8_destroy_context(V8Context context) {
+	V8_EXPORT_SCOPE(v8_destroy_context);
 	delete (Global<Context>*)context;
 }
 
 V8Object __stdcall v8_global_object(V8Context _context) {
+	V8_EXPORT_SCOPE(v8_global_object);
 	auto context = (Global<Context>*)_context;
 	auto isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
 	Local<Context> lcontext = Local<Context>::New(isolate, *context);
-	return (V8Object)new Global<Object>(isolate, lcontext->Global());
+	return (V8Object)NewGlobalHandle(isolate, lcontext->Global());
 }
 
 const uint16_t* __stdcall v8_strinfo(V8String _str, int* len)
 {
+	V8_EXPORT_SCOPE(v8_strinfo);
 	auto str = (String::Value*)_str;
 	if (len)
 		*len = str->length();
@@ -146,11 +184,20 @@ const uint16_t* __stdcall v8_strinfo(V8String _str, int* len)
 
 String::Value* __stdcall v8_val_to_string(const Local<Value>* value)
 {
-	return new String::Value(*value);
+	auto str = new String::Value(*value);
+	V8_COUNT_STRING_BYTES(str->length() * sizeof(uint16_t));
+	return str;
+}
+
+// the exception of a failed eval, handed back like a result
+static V8String ExceptionString(TryCatch* try_catch) {
+	Local<Value> exception = try_catch->Exception();
+	return (V8String)v8_val_to_string(&exception);
 }
 
 void __stdcall v8_destroy_string(V8String p)
 {
+	V8_EXPORT_SCOPE(v8_destroy_string);
 	delete (String::Value*)p;
 }
 
@@ -177,7 +224,7 @@ void ReportException(Isolate* isolate, TryCatch* try_catch) {
 		int linenum = message->GetLineNumber(context).FromJust();
 
 		char buf[4096];
-		sprintf_s(buf, "%s:%i: %s\n", filename_string, linenum, exception_string);
+		snprintf(buf, sizeof(buf), "%s:%i: %s\n", filename_string, linenum, exception_string);
 		OutputDebugStringA(buf);
 		// Print line of source code.
 		String::Utf8Value sourceline(
@@ -186,14 +233,11 @@ void ReportException(Isolate* isolate, TryCatch* try_catch) {
 		OutputDebugStringA(sourceline_string);
 		// Print wavy underline (GetUnderline is deprecated).
 		int start = message->GetStartColumn(context).FromJust();
-		for (int i = 0; i < start; i++) {
-			OutputDebugStringA(" ");
-		}
 		int end = message->GetEndColumn(context).FromJust();
-		for (int i = start; i < end; i++) {
-			OutputDebugStringA("^");
-		}
-		OutputDebugStringA("\n");
+		std::string underline(start, ' ');
+		underline.append(end > start ? end - start : 0, '^');
+		underline += '\n';
+		OutputDebugStringA(underline.c_str());
 		Local<Value> stack_trace_string;
 		if (try_catch->StackTrace(context).ToLocal(&stack_trace_string) &&
 			stack_trace_string->IsString() &&
@@ -207,6 +251,7 @@ void ReportException(Isolate* isolate, TryCatch* try_catch) {
 
 V8String __stdcall v8_eval_asstr(V8Isolate _isolate, V8Context _context, const uint16_t* code)
 {
+	V8_EXPORT_SCOPE(v8_eval_asstr);
 	auto isolate = (Isolate*)_isolate;
 	auto context = (Global<Context>*)_context;
 	if (!isolate)
@@ -234,7 +279,7 @@ V8String __stdcall v8_eval_asstr(V8Isolate _isolate, V8Context _context, const u
 	{
 		OutputDebugStringA("Compile error");
 		ReportException(isolate, &tryCatch);
-		return (V8String)new String::Value(tryCatch.Exception());
+		return ExceptionString(&tryCatch);
 	}
 
 	MaybeLocal<Value> result = script.ToLocalChecked()->Run(lcontext);
@@ -243,7 +288,7 @@ V8String __stdcall v8_eval_asstr(V8Isolate _isolate, V8Context _context, const u
 	{
 		OutputDebugStringA("Run error");
 		ReportException(isolate, &tryCatch);
-		return (V8String)new String::Value(tryCatch.Exception());
+		return ExceptionString(&tryCatch);
 	}
 
 	auto lresult = result.ToLocalChecked();
@@ -256,6 +301,7 @@ BOOL __stdcall v8_set_object(
 	const uint16_t* propName,
 	V8Object _owner,
 	V8Object _propValue) {
+	V8_EXPORT_SCOPE(v8_set_object);
 
 	auto isolate = (Isolate*)_isolate;
 	auto context = (Global<Context>*)_context;
@@ -294,6 +340,7 @@ BOOL __stdcall v8_register_native_function(
 	const char* funcname,
 	V8FunctionCallback func,
 	const void* data) {
+	V8_EXPORT_SCOPE(v8_register_native_function);
 	auto isolate = (Isolate*)_isolate;
 	auto context = (Global<Context>*)_context;
 	if (!isolate)
@@ -318,6 +365,7 @@ BOOL __stdcall v8_register_native_function(
 }
 
 void* __stdcall v8_FunctionCallbackInfo_data(const V8FunctionCallbackInfo _info) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_data);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto data = info->Data();
 	if (data->IsExternal())
@@ -330,13 +378,15 @@ void* __stdcall v8_FunctionCallbackInfo_data(const V8FunctionCallbackInfo _info)
 }
 
 V8Object __stdcall v8_FunctionCallbackInfo_this(const V8FunctionCallbackInfo _info) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_this);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto isolate = info->GetIsolate();
 	HandleScope handleScope(isolate);
-	return new Global<Object>(isolate, info->This());
+	return NewGlobalHandle(isolate, info->This());
 }
 
 void* __stdcall v8_FunctionCallbackInfo_internal_field(const V8FunctionCallbackInfo _info, int idx) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_internal_field);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	HandleScope handleScope(info->GetIsolate());
 	Local<Object> holder = info->Holder();
@@ -353,11 +403,13 @@ void* __stdcall v8_FunctionCallbackInfo_internal_field(const V8FunctionCallbackI
 
 int32_t __stdcall v8_FunctionCallbackInfo_arg_count(const V8FunctionCallbackInfo _info)
 {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_count);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	return info->Length();
 }
 
 V8String __stdcall v8_FunctionCallbackInfo_arg_as_str(const V8FunctionCallbackInfo _info, int idx) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_as_str);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto arg = (*info)[idx];
 	return (V8String)v8_val_to_string(&arg);
@@ -366,6 +418,7 @@ V8String __stdcall v8_FunctionCallbackInfo_arg_as_str(const V8FunctionCallbackIn
 BOOL __stdcall v8_FunctionCallbackInfo_arg_as_int32(
 	const V8FunctionCallbackInfo _info,
 	int idx, int32_t* result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_as_int32);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto isolate = info->GetIsolate();
 	HandleScope handleScope(isolate);
@@ -387,6 +440,7 @@ BOOL __stdcall v8_FunctionCallbackInfo_arg_as_int32(
 BOOL __stdcall v8_FunctionCallbackInfo_arg_as_uint32(
 	const V8FunctionCallbackInfo _info,
 	int idx, uint32_t* result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_as_uint32);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto isolate = info->GetIsolate();
 	HandleScope handleScope(isolate);
@@ -407,6 +461,7 @@ BOOL __stdcall v8_FunctionCallbackInfo_arg_as_uint32(
 BOOL __stdcall v8_FunctionCallbackInfo_arg_as_int64(
 	const V8FunctionCallbackInfo _info,
 	int idx, int64_t* result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_as_int64);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto isolate = info->GetIsolate();
 	HandleScope handleScope(isolate);
@@ -428,6 +483,7 @@ BOOL __stdcall v8_FunctionCallbackInfo_arg_as_int64(
 BOOL __stdcall v8_FunctionCallbackInfo_arg_as_float(
 	const V8FunctionCallbackInfo _info,
 	int idx, double* result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_as_float);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto isolate = info->GetIsolate();
 	HandleScope handleScope(isolate);
@@ -448,6 +504,7 @@ BOOL __stdcall v8_FunctionCallbackInfo_arg_as_float(
 
 V8Object __stdcall v8_FunctionCallbackInfo_arg_as_object(const V8FunctionCallbackInfo _info, int idx)
 {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_arg_as_object);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	auto isolate = info->GetIsolate();
 	HandleScope handleScope(isolate);
@@ -457,35 +514,41 @@ V8Object __stdcall v8_FunctionCallbackInfo_arg_as_object(const V8FunctionCallbac
 	if (tmp.IsEmpty())
 		return nullptr;
 	else
-		return (V8Object)new Global<Object>(isolate, tmp.ToLocalChecked());
+		return (V8Object)NewGlobalHandle(isolate, tmp.ToLocalChecked());
 }
 
 void __stdcall v8_FunctionCallbackInfo_return_int32(const V8FunctionCallbackInfo _info, int32_t result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_return_int32);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	info->GetReturnValue().Set(result);
 }
 
 void __stdcall v8_FunctionCallbackInfo_return_uint32(const V8FunctionCallbackInfo _info, uint32_t result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_return_uint32);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	info->GetReturnValue().Set(result);
 }
 
 void __stdcall v8_FunctionCallbackInfo_return_int64(const V8FunctionCallbackInfo _info, int64_t* result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_return_int64);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	info->GetReturnValue().Set(Number::New(info->GetIsolate(), (double)*result));
 }
 
 void __stdcall v8_FunctionCallbackInfo_return_float(const V8FunctionCallbackInfo _info, double result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_return_float);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	info->GetReturnValue().Set(result);
 }
 
 void __stdcall v8_FunctionCallbackInfo_return_string(const V8FunctionCallbackInfo _info, const uint16_t* result) {
+	V8_EXPORT_SCOPE(v8_FunctionCallbackInfo_return_string);
 	auto info = (const FunctionCallbackInfo<v8::Value>*)_info;
 	info->GetReturnValue().Set(LocalString(info->GetIsolate(), result));
 }
 
 V8ObjectTemplate __stdcall v8_new_object_template(V8Isolate _isolate, int InternalFieldCount) {
+	V8_EXPORT_SCOPE(v8_new_object_template);
 	auto isolate = (Isolate*)_isolate;
 	if (!isolate)
 		isolate = Isolate::GetCurrent();
@@ -496,15 +559,17 @@ V8ObjectTemplate __stdcall v8_new_object_template(V8Isolate _isolate, int Intern
 	HandleScope handle_scope(isolate);
 	Local<ObjectTemplate> objTemplate = ObjectTemplate::New(isolate);
 	objTemplate->SetInternalFieldCount(InternalFieldCount);
-	return (V8ObjectTemplate)new Global<ObjectTemplate>(isolate, objTemplate);
+	return (V8ObjectTemplate)NewGlobalHandle(isolate, objTemplate);
 }
 
 void __stdcall v8_destroy_object_template(V8ObjectTemplate objTemplate) {
+	V8_EXPORT_SCOPE(v8_destroy_object_template);
 	delete (Global<ObjectTemplate>*)objTemplate;
 }
 
 BOOL __stdcall v8_object_template_add_method(V8Isolate _isolate, V8Context _context, V8ObjectTemplate _objTemplate,
 	const char* name, V8FunctionCallback func, const void* data) {
+	V8_EXPORT_SCOPE(v8_object_template_add_method);
 	auto isolate = (Isolate*)_isolate;
 	auto context = (Global<Context>*)_context;
 	auto objTemplate = (Global<ObjectTemplate>*)_objTemplate;
@@ -537,6 +602,7 @@ BOOL __stdcall v8_object_template_add_method(V8Isolate _isolate, V8Context _cont
 
 V8Object __stdcall v8_new_object(V8Isolate _isolate, V8Context _context,
 	V8ObjectTemplate _objTemplate, void* FirstInternalField) {
+	V8_EXPORT_SCOPE(v8_new_object);
 	auto isolate = (Isolate*)_isolate;
 	auto context = (Global<Context>*)_context;
 	auto objTemplate = (Global<ObjectTemplate>*)_objTemplate;
@@ -565,15 +631,17 @@ V8Object __stdcall v8_new_object(V8Isolate _isolate, V8Context _context,
 		if (result->InternalFieldCount() > 0)
 			result->SetInternalField(0, External::New(isolate, FirstInternalField));
 
-		return new Global<Object>(isolate, result);
+		return NewGlobalHandle(isolate, result);
 	}
 }
 
 void __stdcall v8_destroy_object(V8Object obj) {
+	V8_EXPORT_SCOPE(v8_destroy_object);
 	delete (Global<Object>*)obj;
 }
 
 int __stdcall v8_object_internal_field_count(V8Object _obj) {
+	V8_EXPORT_SCOPE(v8_object_internal_field_count);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -582,6 +650,7 @@ int __stdcall v8_object_internal_field_count(V8Object _obj) {
 }
 
 void* __stdcall v8_object_get_internal_field(V8Object _obj, int idx) {
+	V8_EXPORT_SCOPE(v8_object_get_internal_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -599,6 +668,7 @@ void* __stdcall v8_object_get_internal_field(V8Object _obj, int idx) {
 }
 
 void __stdcall v8_object_set_internal_field(V8Object _obj, int idx, void* value) {
+	V8_EXPORT_SCOPE(v8_object_set_internal_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -609,6 +679,7 @@ void __stdcall v8_object_set_internal_field(V8Object _obj, int idx, void* value)
 }
 
 int32_t __stdcall v8_object_get_int32_field(V8Object _obj, const uint16_t* name, int32_t defValue) {
+	V8_EXPORT_SCOPE(v8_object_get_int32_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -627,6 +698,7 @@ int32_t __stdcall v8_object_get_int32_field(V8Object _obj, const uint16_t* name,
 }
 
 uint32_t __stdcall v8_object_get_uint32_field(V8Object _obj, const uint16_t* name, uint32_t defValue) {
+	V8_EXPORT_SCOPE(v8_object_get_uint32_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -645,6 +717,7 @@ uint32_t __stdcall v8_object_get_uint32_field(V8Object _obj, const uint16_t* nam
 }
 
 BOOL __stdcall v8_object_get_float_field(V8Object _obj, const uint16_t* name, double* value) {
+	V8_EXPORT_SCOPE(v8_object_get_float_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -666,6 +739,7 @@ BOOL __stdcall v8_object_get_float_field(V8Object _obj, const uint16_t* name, do
 }
 
 BOOL __stdcall v8_object_get_int64_field(V8Object _obj, const uint16_t* name, int64_t* value) {
+	V8_EXPORT_SCOPE(v8_object_get_int64_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -687,6 +761,7 @@ BOOL __stdcall v8_object_get_int64_field(V8Object _obj, const uint16_t* name, in
 }
 
 V8String __stdcall v8_object_get_string_field(V8Object _obj, const uint16_t* name) {
+	V8_EXPORT_SCOPE(v8_object_get_string_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -702,6 +777,7 @@ V8String __stdcall v8_object_get_string_field(V8Object _obj, const uint16_t* nam
 }
 
 V8Object __stdcall v8_object_get_object_field(V8Object _obj, const uint16_t* name) {
+	V8_EXPORT_SCOPE(v8_object_get_object_field);
 	auto obj = (Global<Object>*)_obj;
 	Isolate *isolate = Isolate::GetCurrent();
 	HandleScope handleScope(isolate);
@@ -715,6 +791,1605 @@ V8Object __stdcall v8_object_get_object_field(V8Object _obj, const uint16_t* nam
 		if (tmp.IsEmpty())
 			return nullptr;
 		else
-			return (V8Object)new Global<Object>(isolate, tmp.ToLocalChecked());
+			return (V8Object)NewGlobalHandle(isolate, tmp.ToLocalChecked());
+	}
+}
+
+BOOL __stdcall v8_enable_metrics(BOOL enable) {
+	V8_EXPORT_SCOPE(v8_enable_metrics);
+#ifdef V8DLL_METRICS
+	return v8dll_metrics::enabled.exchange(enable != FALSE) ? TRUE : FALSE;
+#else
+	(void)enable;
+	return FALSE;
+#endif
+}
+
+void __stdcall v8_reset_metrics() {
+	V8_EXPORT_SCOPE(v8_reset_metrics);
+#ifdef V8DLL_METRICS
+	v8dll_metrics::Reset();
+#endif
+}
+
+int __stdcall v8_get_metrics(char* buffer, int size) {
+	V8_EXPORT_SCOPE(v8_get_metrics);
+#ifdef V8DLL_METRICS
+	std::string json = v8dll_metrics::Snapshot();
+	int len = (int)json.size();
+	if (buffer && size > len)
+		memcpy(buffer, json.c_str(), len + 1);
+	return len;
+#else
+	(void)buffer;
+	(void)size;
+	return 0;
+#endif
+}
+
+V8Object __stdcall v8_new_int32_array(V8Isolate _isolate, V8Context _context,
+	const int32_t* data, int count, BOOL typed) {
+	V8_EXPORT_SCOPE(v8_new_int32_array);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || count < 0)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+	Local<Object> result;
+
+	if (typed) {
+		Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate, count * sizeof(int32_t));
+		if (count)
+			memcpy(buffer->GetContents().Data(), data, count * sizeof(int32_t));
+		result = Int32Array::New(buffer, 0, count);
+	}
+	else {
+		Local<Array> arr = Array::New(isolate, count);
+		for (int i = 0; i < count; i++) {
+			HandleScope element_scope(isolate);
+			if (!arr->Set(lcontext, i, Integer::New(isolate, data[i])).FromMaybe(false))
+				return nullptr;
+		}
+		result = arr;
+	}
+
+	return NewGlobalHandle(isolate, result);
+}
+
+V8Object __stdcall v8_new_float_array(V8Isolate _isolate, V8Context _context,
+	const double* data, int count, BOOL typed) {
+	V8_EXPORT_SCOPE(v8_new_float_array);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || count < 0)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+	Local<Object> result;
+
+	if (typed) {
+		Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate, count * sizeof(double));
+		if (count)
+			memcpy(buffer->GetContents().Data(), data, count * sizeof(double));
+		result = Float64Array::New(buffer, 0, count);
+	}
+	else {
+		Local<Array> arr = Array::New(isolate, count);
+		for (int i = 0; i < count; i++) {
+			HandleScope element_scope(isolate);
+			if (!arr->Set(lcontext, i, Number::New(isolate, data[i])).FromMaybe(false))
+				return nullptr;
+		}
+		result = arr;
+	}
+
+	return NewGlobalHandle(isolate, result);
+}
+
+V8Object __stdcall v8_new_string_array(V8Isolate _isolate, V8Context _context,
+	const uint16_t* const* data, int count) {
+	V8_EXPORT_SCOPE(v8_new_string_array);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || count < 0)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+	Local<Array> arr = Array::New(isolate, count);
+
+	for (int i = 0; i < count; i++) {
+		HandleScope element_scope(isolate);
+		Local<Value> element;
+		if (data[i])
+			element = LocalString(isolate, data[i]);
+		else
+			element = Null(isolate);
+		if (!arr->Set(lcontext, i, element).FromMaybe(false))
+			return nullptr;
+	}
+
+	return NewGlobalHandle(isolate, Local<Object>(arr));
+}
+
+V8Object __stdcall v8_new_array_from_values(V8Isolate _isolate, V8Context _context,
+	const V8TaggedValue* values, int count) {
+	V8_EXPORT_SCOPE(v8_new_array_from_values);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || count < 0)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+	Local<Array> arr = Array::New(isolate, count);
+
+	for (int i = 0; i < count; i++) {
+		HandleScope element_scope(isolate);
+		const V8TaggedValue& value = values[i];
+		Local<Value> element;
+		switch (value.type) {
+		case V8_VALUE_NULL:
+			element = Null(isolate);
+			break;
+
+		case V8_VALUE_BOOL:
+			element = Boolean::New(isolate, value.b != FALSE);
+			break;
+
+		case V8_VALUE_INT32:
+			element = Integer::New(isolate, value.i);
+			break;
+
+		case V8_VALUE_FLOAT:
+			element = Number::New(isolate, value.f);
+			break;
+
+		case V8_VALUE_STRING:
+			if (value.s)
+				element = LocalString(isolate, value.s);
+			else
+				element = Null(isolate);
+			break;
+
+		case V8_VALUE_OBJECT:
+			if (value.o)
+				element = Local<Object>::New(isolate, *(Global<Object>*)value.o);
+			else
+				element = Null(isolate);
+			break;
+
+		default:
+			element = Undefined(isolate);
+			break;
+		}
+
+		if (!arr->Set(lcontext, i, element).FromMaybe(false))
+			return nullptr;
+	}
+
+	return NewGlobalHandle(isolate, Local<Object>(arr));
+}
+
+// length of an array, typed array or array-like object, -1 if it has none
+static int64_t ArrayLikeLength(Isolate* isolate, Local<Context> context, Local<Object> obj) {
+	if (obj->IsArray())
+		return Local<Array>::Cast(obj)->Length();
+
+	if (obj->IsTypedArray())
+		return (int64_t)Local<TypedArray>::Cast(obj)->Length();
+
+	auto length = obj->Get(context, LocalStringFromUtf8(isolate, "length"));
+	if (length.IsEmpty())
+		return -1;
+
+	auto tmp = length.ToLocalChecked()->Uint32Value(context);
+	return tmp.IsJust() ? (int64_t)tmp.FromJust() : -1;
+}
+
+int __stdcall v8_array_length(V8Object _obj) {
+	V8_EXPORT_SCOPE(v8_array_length);
+	auto obj = (Global<Object>*)_obj;
+	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope handleScope(isolate);
+	auto context = isolate->GetCurrentContext();
+	Local<Object> lobj = Local<Object>::New(isolate, *obj);
+	return (int)ArrayLikeLength(isolate, context, lobj);
+}
+
+// embedder data slot of a context holding the original
+// %TypedArray%.prototype.set (slot 0 is the debugger's)
+static const int kTypedArraySetSlot = 1;
+
+// taken before any script runs in the context, so later replacements of the
+// prototype method by script are never called by the exports
+static void CacheContextBuiltins(Isolate* isolate, Local<Context> context) {
+	Context::Scope context_scope(context);
+	Local<Value> proto = Int32Array::New(ArrayBuffer::New(isolate, 0), 0, 0)
+		->GetPrototype().As<Object>()->GetPrototype();
+	if (!proto->IsObject())
+		return;
+
+	Local<Value> set;
+	if (proto.As<Object>()->Get(context, LocalStringFromUtf8(isolate, "set")).ToLocal(&set) && set->IsFunction())
+		context->SetEmbedderData(kTypedArraySetSlot, set);
+}
+
+static MaybeLocal<Function> TypedArraySet(Local<Context> context) {
+	if (context->GetNumberOfEmbedderDataFields() <= (uint32_t)kTypedArraySetSlot)
+		return MaybeLocal<Function>();
+
+	Local<Value> set = context->GetEmbedderData(kTypedArraySetSlot);
+	if (!set->IsFunction())
+		return MaybeLocal<Function>();
+	return set.As<Function>();
+}
+
+// Reads a JS Array with the original TypedArray.prototype.set into a typed
+// array over the native buffer, which V8 copies without a lookup per index
+// for packed SMI and double elements. set copies the whole source, so a
+// window of a longer array goes through a temporary buffer. Returns false if
+// the context has no cached set (not created by v8_new_context) or set threw.
+static bool CopyArrayWithSet(Isolate* isolate, Local<Context> context, Local<Array> source,
+	int start, void* buffer, int n, bool is_double) {
+	Local<Function> set;
+	if (!TypedArraySet(context).ToLocal(&set))
+		return false;
+
+	size_t element_size = is_double ? sizeof(double) : sizeof(int32_t);
+	size_t length = source->Length();
+	std::vector<char> whole;
+	void* target_data = buffer;
+	if (start != 0 || (size_t)n != length) {
+		whole.resize(length * element_size);
+		target_data = whole.data();
+	}
+
+	// host memory, neutered below so no view can outlive this call
+	Local<ArrayBuffer> target_buffer = ArrayBuffer::New(isolate, target_data, length * element_size,
+		ArrayBufferCreationMode::kExternalized);
+	Local<Value> target = is_double
+		? Local<Value>(Float64Array::New(target_buffer, 0, length))
+		: Local<Value>(Int32Array::New(target_buffer, 0, length));
+	Local<Value> args[] = { source };
+	bool ok = !set->Call(context, target, 1, args).IsEmpty();
+	target_buffer->Neuter();
+
+	if (ok && target_data != buffer)
+		memcpy(buffer, whole.data() + start * element_size, n * element_size);
+	return ok;
+}
+
+//
+// Copies elements [start, start + count) of an array-like object into a
+// native buffer of int32 or double and returns the number copied, or -1.
+// A typed array of the same element type is copied with CopyContents, which
+// leaves the ownership of its backing store alone, and a JS Array with the
+// cached TypedArray.prototype.set. Anything else is read element by element
+// with the same ToInt32/ToNumber conversion as v8_object_get_*_field.
+//
+static int CopyArrayElements(Isolate* isolate, Local<Object> source, int start,
+	void* buffer, int count, bool is_double) {
+	auto context = isolate->GetCurrentContext();
+	size_t element_size = is_double ? sizeof(double) : sizeof(int32_t);
+	int64_t length = ArrayLikeLength(isolate, context, source);
+
+	if (length < 0 || start < 0 || count < 0)
+		return -1;
+
+	int n = (int)std::min<int64_t>(count, std::max<int64_t>(length - start, 0));
+	if (n == 0)
+		return 0;
+
+	if (is_double ? source->IsFloat64Array() : source->IsInt32Array()) {
+		auto view = Local<TypedArray>::Cast(source);
+		if (start == 0) {
+			view->CopyContents(buffer, n * element_size);
+		}
+		else {
+			// CopyContents always starts at the view's first element
+			std::vector<char> head((start + (size_t)n) * element_size);
+			view->CopyContents(head.data(), head.size());
+			memcpy(buffer, head.data() + start * element_size, n * element_size);
+		}
+		return n;
+	}
+
+	if (source->IsArray()) {
+		TryCatch try_catch(isolate);
+		if (CopyArrayWithSet(isolate, context, Local<Array>::Cast(source), start, buffer, n, is_double))
+			return n;
+		// a getter that throws throws again below, and is reported there
+	}
+
+	for (int i = 0; i < n; i++) {
+		HandleScope element_scope(isolate);
+		Local<Value> element;
+		if (!source->Get(context, (uint32_t)(start + i)).ToLocal(&element))
+			return -1;
+		if (is_double) {
+			auto value = element->NumberValue(context);
+			if (value.IsNothing())
+				return -1;
+			((double*)buffer)[i] = value.FromJust();
+		}
+		else {
+			auto value = element->Int32Value(context);
+			if (value.IsNothing())
+				return -1;
+			((int32_t*)buffer)[i] = value.FromJust();
+		}
+	}
+	return n;
+}
+
+int __stdcall v8_array_get_int32(V8Object _obj, int start, int32_t* buffer, int count) {
+	V8_EXPORT_SCOPE(v8_array_get_int32);
+	auto obj = (Global<Object>*)_obj;
+	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope handleScope(isolate);
+	Local<Object> lobj = Local<Object>::New(isolate, *obj);
+	return CopyArrayElements(isolate, lobj, start, buffer, count, false);
+}
+
+int __stdcall v8_array_get_float(V8Object _obj, int start, double* buffer, int count) {
+	V8_EXPORT_SCOPE(v8_array_get_float);
+	auto obj = (Global<Object>*)_obj;
+	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope handleScope(isolate);
+	Local<Object> lobj = Local<Object>::New(isolate, *obj);
+	return CopyArrayElements(isolate, lobj, start, buffer, count, true);
+}
+
+int __stdcall v8_array_get_strings(V8Object _obj, int start, V8String* buffer, int count) {
+	V8_EXPORT_SCOPE(v8_array_get_strings);
+	auto obj = (Global<Object>*)_obj;
+	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope handleScope(isolate);
+	auto context = isolate->GetCurrentContext();
+	Local<Object> lobj = Local<Object>::New(isolate, *obj);
+
+	int64_t length = ArrayLikeLength(isolate, context, lobj);
+	if (length < 0 || start < 0 || count < 0)
+		return -1;
+
+	int n = (int)std::min<int64_t>(count, std::max<int64_t>(length - start, 0));
+	for (int i = 0; i < n; i++) {
+		HandleScope element_scope(isolate);
+		auto element = lobj->Get(context, (uint32_t)(start + i));
+		if (element.IsEmpty()) {
+			for (int j = 0; j < i; j++)
+				v8_destroy_string(buffer[j]);
+			return -1;
+		}
+		auto tmp = element.ToLocalChecked();
+		buffer[i] = v8_val_to_string(&tmp);
+	}
+
+	return n;
+}
+
+//
+// Class binding: one FunctionTemplate per native class, methods on its
+// PrototypeTemplate with a Signature, so every instance shares the prototype
+// and hidden class and methods reject foreign receivers. Internal field 0
+// holds the native instance, as with v8_new_object.
+//
+// The template's data points at the binding, and installed constructors may
+// be called after v8_destroy_class, so destroying only marks the binding
+// dead; it is freed with its isolate.
+//
+
+struct ClassBinding {
+	Isolate* isolate;
+	Global<FunctionTemplate> tmpl;
+	std::string name;
+	V8ClassConstructor constructor;
+	V8ClassFinalizer finalizer;
+	void* data;
+	ClassBinding* parent;
+	// V8 does not allow a template to change once a function was made from it
+	bool instantiated;
+	bool dead;
+};
+
+static std::mutex retired_classes_lock;
+static std::vector<ClassBinding*> retired_classes;
+
+static void FreeRetiredClasses(Isolate* isolate) {
+	std::lock_guard<std::mutex> lock(retired_classes_lock);
+	auto end = std::remove_if(retired_classes.begin(), retired_classes.end(), [isolate](ClassBinding* binding) {
+		if (binding->isolate != isolate)
+			return false;
+		delete binding;
+		return true;
+	});
+	retired_classes.erase(end, retired_classes.end());
+}
+
+// instantiating a class instantiates the classes it inherits from as well
+static void MarkInstantiated(ClassBinding* binding) {
+	for (; binding; binding = binding->parent)
+		binding->instantiated = true;
+}
+
+// owned by the weak handle, copies the finalizer so instances may outlive the class
+struct WeakInstance {
+	Global<Object> handle;
+	V8ClassFinalizer finalizer;
+	void* instance;
+	void* data;
+};
+
+static void FinalizeInstance(const WeakCallbackInfo<WeakInstance>& info) {
+	WeakInstance* weak = info.GetParameter();
+	weak->finalizer(weak->instance, weak->data);
+	delete weak;
+}
+
+static void ReleaseInstance(const WeakCallbackInfo<WeakInstance>& info) {
+	// no V8 calls are allowed in the first pass, call out to the host in the second
+	info.GetParameter()->handle.Reset();
+	info.SetSecondPassCallback(FinalizeInstance);
+}
+
+static void WrapInstance(ClassBinding* binding, Local<Object> obj, void* instance) {
+	obj->SetInternalField(0, External::New(binding->isolate, instance));
+
+	if (binding->finalizer) {
+		auto weak = new WeakInstance();
+		weak->handle.Reset(binding->isolate, obj);
+		weak->finalizer = binding->finalizer;
+		weak->instance = instance;
+		weak->data = binding->data;
+		weak->handle.SetWeak(weak, ReleaseInstance, WeakCallbackType::kParameter);
+	}
+}
+
+static void ConstructInstance(const FunctionCallbackInfo<Value>& info) {
+	auto isolate = info.GetIsolate();
+	auto binding = (ClassBinding*)Local<External>::Cast(info.Data())->Value();
+	char buf[256];
+
+	if (binding->dead) {
+		isolate->ThrowException(Exception::TypeError(LocalStringFromUtf8(isolate, "Illegal constructor")));
+		return;
+	}
+
+	if (!info.IsConstructCall()) {
+		snprintf(buf, sizeof(buf), "Class constructor %s cannot be invoked without 'new'", binding->name.c_str());
+		isolate->ThrowException(Exception::TypeError(LocalStringFromUtf8(isolate, buf)));
+		return;
 	}
+
+	if (!binding->constructor) {
+		isolate->ThrowException(Exception::TypeError(LocalStringFromUtf8(isolate, "Illegal constructor")));
+		return;
+	}
+
+	TryCatch try_catch(isolate);
+	void* instance = binding->constructor((V8FunctionCallbackInfo)&info, binding->data);
+
+	if (try_catch.HasCaught()) {
+		try_catch.ReThrow();
+		return;
+	}
+
+	if (!instance) {
+		snprintf(buf, sizeof(buf), "%s constructor returned no instance", binding->name.c_str());
+		isolate->ThrowException(Exception::TypeError(LocalStringFromUtf8(isolate, buf)));
+		return;
+	}
+
+	WrapInstance(binding, info.This(), instance);
+}
+
+V8Class __stdcall v8_new_class(V8Isolate _isolate, const char* name, int InternalFieldCount,
+	V8ClassConstructor constructor, V8ClassFinalizer finalizer, const void* data) {
+	V8_EXPORT_SCOPE(v8_new_class);
+	auto isolate = (Isolate*)_isolate;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || !name)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	auto binding = new ClassBinding();
+	binding->isolate = isolate;
+	binding->name = name;
+	binding->constructor = constructor;
+	binding->finalizer = finalizer;
+	binding->data = (void*)data;
+
+	Local<FunctionTemplate> tmpl = FunctionTemplate::New(isolate, ConstructInstance,
+		External::New(isolate, binding));
+	tmpl->SetClassName(LocalStringFromUtf8(isolate, name));
+	tmpl->InstanceTemplate()->SetInternalFieldCount(InternalFieldCount > 0 ? InternalFieldCount : 1);
+	binding->tmpl.Reset(isolate, tmpl);
+	V8_COUNT_HANDLES(1);
+	return (V8Class)binding;
+}
+
+void __stdcall v8_destroy_class(V8Class cls) {
+	V8_EXPORT_SCOPE(v8_destroy_class);
+	auto binding = (ClassBinding*)cls;
+	if (!binding || binding->dead)
+		return;
+
+	// live instances keep finalizing, they hold copies of finalizer and data
+	binding->dead = true;
+	binding->tmpl.Reset();
+	std::lock_guard<std::mutex> lock(retired_classes_lock);
+	retired_classes.push_back(binding);
+}
+
+BOOL __stdcall v8_class_add_method(V8Class cls, const char* name, V8FunctionCallback func, const void* data) {
+	V8_EXPORT_SCOPE(v8_class_add_method);
+	auto binding = (ClassBinding*)cls;
+	if (!binding || !name || binding->dead || binding->instantiated)
+		return FALSE;
+
+	auto isolate = binding->isolate;
+	HandleScope handle_scope(isolate);
+	Local<FunctionTemplate> tmpl = Local<FunctionTemplate>::New(isolate, binding->tmpl);
+	Local<FunctionTemplate> method = FunctionTemplate::New(isolate, (FunctionCallback)func,
+		External::New(isolate, (void*)data), Signature::New(isolate, tmpl));
+	tmpl->PrototypeTemplate()->Set(LocalStringFromUtf8(isolate, name), method);
+	return TRUE;
+}
+
+BOOL __stdcall v8_class_inherit(V8Class cls, V8Class parent) {
+	V8_EXPORT_SCOPE(v8_class_inherit);
+	auto binding = (ClassBinding*)cls;
+	auto parentBinding = (ClassBinding*)parent;
+	if (!binding || !parentBinding || binding->isolate != parentBinding->isolate)
+		return FALSE;
+
+	if (binding->dead || parentBinding->dead || binding->instantiated || binding->parent)
+		return FALSE;
+
+	auto isolate = binding->isolate;
+	HandleScope handle_scope(isolate);
+	Local<FunctionTemplate> tmpl = Local<FunctionTemplate>::New(isolate, binding->tmpl);
+	tmpl->Inherit(Local<FunctionTemplate>::New(isolate, parentBinding->tmpl));
+	binding->parent = parentBinding;
+	return TRUE;
+}
+
+BOOL __stdcall v8_class_install(V8Isolate _isolate, V8Context _context, V8Class cls) {
+	V8_EXPORT_SCOPE(v8_class_install);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	auto binding = (ClassBinding*)cls;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || !binding || binding->dead)
+		return FALSE;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+	Local<FunctionTemplate> tmpl = Local<FunctionTemplate>::New(isolate, binding->tmpl);
+	MarkInstantiated(binding);
+	auto func = tmpl->GetFunction(lcontext);
+
+	if (func.IsEmpty())
+		return FALSE;
+
+	auto result = lcontext->Global()->Set(lcontext, LocalStringFromUtf8(isolate, binding->name.c_str()),
+		func.ToLocalChecked());
+	return result.FromMaybe(false);
+}
+
+V8Object __stdcall v8_class_new_instance(V8Isolate _isolate, V8Context _context,
+	V8Class cls, void* FirstInternalField) {
+	V8_EXPORT_SCOPE(v8_class_new_instance);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	auto binding = (ClassBinding*)cls;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || !binding || binding->dead)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+	Local<FunctionTemplate> tmpl = Local<FunctionTemplate>::New(isolate, binding->tmpl);
+	MarkInstantiated(binding);
+
+	// instantiated from the class's initial map without running the JS constructor
+	auto obj = tmpl->InstanceTemplate()->NewInstance(lcontext);
+
+	if (obj.IsEmpty())
+		return nullptr;
+	else {
+		auto result = obj.ToLocalChecked();
+		WrapInstance(binding, result, FirstInternalField);
+		return NewGlobalHandle(isolate, result);
+	}
+}
+
+BOOL __stdcall v8_inspector_start(V8Isolate _isolate, V8Context _context, int port, BOOL waitForDebugger) {
+	V8_EXPORT_SCOPE(v8_inspector_start);
+#ifdef V8DLL_INSPECTOR
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate)
+		return FALSE;
+
+	Isolate::Scope isolate_scope(isolate);
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+
+	if (lcontext.IsEmpty())
+		return FALSE;
+
+	Context::Scope context_scope(lcontext);
+	return v8dll_inspector::Start(isolate, lcontext, port, waitForDebugger != FALSE) ? TRUE : FALSE;
+#else
+	(void)_isolate;
+	(void)_context;
+	(void)port;
+	(void)waitForDebugger;
+	return FALSE;
+#endif
+}
+
+void __stdcall v8_inspector_stop(V8Isolate _isolate) {
+	V8_EXPORT_SCOPE(v8_inspector_stop);
+#ifdef V8DLL_INSPECTOR
+	auto isolate = (Isolate*)_isolate;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate)
+		return;
+
+	Isolate::Scope isolate_scope(isolate);
+	v8dll_inspector::Stop(isolate);
+#else
+	(void)_isolate;
+#endif
+}
+
+int __stdcall v8_inspector_poll(V8Isolate _isolate) {
+	V8_EXPORT_SCOPE(v8_inspector_poll);
+#ifdef V8DLL_INSPECTOR
+	auto isolate = (Isolate*)_isolate;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate)
+		return -1;
+
+	Isolate::Scope isolate_scope(isolate);
+	HandleScope handle_scope(isolate);
+	return v8dll_inspector::Poll(isolate);
+#else
+	(void)_isolate;
+	return -1;
+#endif
+}
+
+class FileOutputStream : public OutputStream {
+public:
+	explicit FileOutputStream(FILE* file) : file_(file), failed_(false) {}
+
+	virtual void EndOfStream() {}
+	virtual int GetChunkSize() { return 64 * 1024; }
+
+	virtual WriteResult WriteAsciiChunk(char* data, int size) {
+		if (fwrite(data, 1, size, file_) != (size_t)size) {
+			failed_ = true;
+			return kAbort;
+		}
+		return kContinue;
+	}
+
+	bool failed() const { return failed_; }
+
+private:
+	FILE* file_;
+	bool failed_;
+};
+
+// also used by the inspector, whose socket speaks UTF-8; unpaired surrogates
+// are encoded as they are
+std::string Utf16ToUtf8(const uint16_t* s, size_t length) {
+	std::string out;
+	out.reserve(length);
+	for (size_t i = 0; i < length; i++) {
+		uint32_t c = s[i];
+		if (c >= 0xD800 && c < 0xDC00 && i + 1 < length && s[i + 1] >= 0xDC00 && s[i + 1] < 0xE000)
+			c = 0x10000 + ((c - 0xD800) << 10) + (s[++i] - 0xDC00);
+		if (c < 0x80)
+			out += (char)c;
+		else if (c < 0x800) {
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000) {
+			out += (char)(0xE0 | (c >> 12));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else {
+			out += (char)(0xF0 | (c >> 18));
+			out += (char)(0x80 | ((c >> 12) & 0x3F));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return out;
+}
+
+#ifndef _WIN32
+// file names cross the exports as UTF-16, POSIX file APIs take UTF-8
+static std::string NativePath(const uint16_t* filename) {
+	size_t length = 0;
+	while (filename[length])
+		length++;
+	return Utf16ToUtf8(filename, length);
+}
+#endif
+
+static FILE* OpenFileForWrite(const uint16_t* filename) {
+#ifdef _WIN32
+	return _wfopen((const wchar_t*)filename, L"wb");
+#else
+	return fopen(NativePath(filename).c_str(), "wb");
+#endif
+}
+
+static void RemoveFile(const uint16_t* filename) {
+#ifdef _WIN32
+	_wremove((const wchar_t*)filename);
+#else
+	remove(NativePath(filename).c_str());
+#endif
+}
+
+// replaces an existing target
+static bool RenameFile(const uint16_t* from, const uint16_t* to) {
+#ifdef _WIN32
+	return MoveFileExW((const wchar_t*)from, (const wchar_t*)to, MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+	return rename(NativePath(from).c_str(), NativePath(to).c_str()) == 0;
+#endif
+}
+
+BOOL __stdcall v8_write_heap_snapshot(V8Isolate _isolate, const uint16_t* filename) {
+	V8_EXPORT_SCOPE(v8_write_heap_snapshot);
+	auto isolate = (Isolate*)_isolate;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || !filename)
+		return FALSE;
+
+	// written next to the target and renamed once complete, so a failure never
+	// leaves an empty or truncated snapshot under the requested name
+	std::u16string temp((const char16_t*)filename);
+	temp += u".tmp";
+	FILE* file = OpenFileForWrite((const uint16_t*)temp.c_str());
+	if (!file) {
+		OutputDebugStringA("v8_write_heap_snapshot: cannot open file");
+		return FALSE;
+	}
+
+	Isolate::Scope isolate_scope(isolate);
+	HandleScope handle_scope(isolate);
+	const HeapSnapshot* snapshot = isolate->GetHeapProfiler()->TakeHeapSnapshot();
+	FileOutputStream stream(file);
+
+	if (snapshot) {
+		snapshot->Serialize(&stream, HeapSnapshot::kJSON);
+		const_cast<HeapSnapshot*>(snapshot)->Delete();
+	}
+
+	bool ok = snapshot && !stream.failed();
+	if (fclose(file) != 0)
+		ok = false;
+	if (ok && !RenameFile((const uint16_t*)temp.c_str(), filename))
+		ok = false;
+
+	if (!ok) {
+		OutputDebugStringA("v8_write_heap_snapshot: cannot write snapshot");
+		RemoveFile((const uint16_t*)temp.c_str());
+	}
+	return ok ? TRUE : FALSE;
+}
+
+V8Object __stdcall v8_json_parse(V8Isolate _isolate, V8Context _context, const void* json, int length, int encoding) {
+	V8_EXPORT_SCOPE(v8_json_parse);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || !json)
+		return nullptr;
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+
+	MaybeLocal<String> source;
+	if (encoding == V8_UTF16)
+		source = String::NewFromTwoByte(isolate, (const uint16_t*)json, NewStringType::kNormal, length);
+	else
+		source = String::NewFromUtf8(isolate, (const char*)json, NewStringType::kNormal, length);
+
+	if (source.IsEmpty()) {
+		OutputDebugStringA("v8_json_parse: document exceeds the maximum string length");
+		return nullptr;
+	}
+
+	TryCatch tryCatch(isolate);
+	auto result = JSON::Parse(lcontext, CountInputString(source.ToLocalChecked()));
+
+	if (result.IsEmpty()) {
+		String::Utf8Value exception(tryCatch.Exception());
+		OutputDebugStringA(ToCString(exception));
+		return nullptr;
+	}
+
+	// primitive documents come back wrapped, "null" has no object form
+	auto obj = result.ToLocalChecked()->ToObject(lcontext);
+	if (obj.IsEmpty())
+		return nullptr;
+	else
+		return NewGlobalHandle(isolate, obj.ToLocalChecked());
+}
+
+// stringifies a value, false if it has no JSON representation (undefined,
+// functions, symbols, or a toJSON returning one of those) or if it threw
+static bool StringifyValue(Local<Context> context, Local<Value> value, Local<String> undefined_json,
+	Local<String>* json) {
+	if (value->IsUndefined() || value->IsFunction() || value->IsSymbol())
+		return false;
+	if (!JSON::Stringify(context, value).ToLocal(json))
+		return false;
+	// JSON::Stringify converts an undefined result to the string "undefined"
+	return !(*json)->StrictEquals(undefined_json);
+}
+
+static int64_t EncodedSize(Local<String> str, int encoding) {
+	if (encoding == V8_UTF16)
+		return (int64_t)str->Length() * sizeof(uint16_t);
+	else
+		return str->Utf8Length();
+}
+
+static void EncodeString(Local<String> str, int encoding, char* buffer, int size) {
+	if (encoding == V8_UTF16)
+		str->Write((uint16_t*)buffer, 0, -1, String::NO_NULL_TERMINATION);
+	else
+		str->WriteUtf8(buffer, size, nullptr, String::NO_NULL_TERMINATION | String::REPLACE_INVALID_UTF8);
+	V8_COUNT_STRING_BYTES(size);
+}
+
+int __stdcall v8_json_stringify(V8Object _obj, const uint16_t* gap, int encoding, V8Buffer* buffer) {
+	V8_EXPORT_SCOPE(v8_json_stringify);
+	auto obj = (Global<Object>*)_obj;
+	if (!obj || !buffer)
+		return -1;
+
+	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope handleScope(isolate);
+	auto context = isolate->GetCurrentContext();
+	Local<Object> lobj = Local<Object>::New(isolate, *obj);
+	TryCatch tryCatch(isolate);
+	Local<String> json;
+
+	buffer->size = 0;
+	if (!JSON::Stringify(context, lobj, gap ? LocalString(isolate, gap) : Local<String>()).ToLocal(&json)) {
+		String::Utf8Value exception(tryCatch.Exception());
+		OutputDebugStringA(ToCString(exception));
+		return -1;
+	}
+
+	if (json->StrictEquals(LocalStringFromUtf8(isolate, "undefined")))
+		return -1;
+
+	int64_t size = EncodedSize(json, encoding);
+	if (size > INT_MAX)
+		return -1;
+
+	if (size > buffer->capacity) {
+		// without a grow callback the caller retries with the returned size
+		if (!buffer->grow || !buffer->grow(buffer, (int)size) || size > buffer->capacity)
+			return (int)size;
+	}
+
+	EncodeString(json, encoding, buffer->data, (int)size);
+	buffer->size = (int)size;
+	return (int)size;
+}
+
+//
+// batches encoded output into chunks of about kChunkSize bytes for the host's
+// write callback, so only one member of the document is held at a time
+//
+class JsonStreamWriter {
+public:
+	static const size_t kChunkSize = 64 * 1024;
+
+	JsonStreamWriter(int encoding, V8WriteCallback write, void* user)
+		: encoding_(encoding), write_(write), user_(user), written_(0), failed_(false) {
+		chunk_.reserve(kChunkSize);
+	}
+
+	void Append(const char* ascii) {
+		for (; *ascii; ascii++) {
+			if (encoding_ == V8_UTF16) {
+				uint16_t c = (uint8_t)*ascii;
+				chunk_.append((const char*)&c, sizeof(c));
+			}
+			else
+				chunk_ += *ascii;
+		}
+		if (chunk_.size() >= kChunkSize)
+			Flush();
+	}
+
+	void Append(Local<String> str) {
+		int64_t size = EncodedSize(str, encoding_);
+		if (chunk_.size() + size > kChunkSize)
+			Flush();
+		if (size > INT_MAX) {
+			failed_ = true;
+			return;
+		}
+		size_t offset = chunk_.size();
+		chunk_.resize(offset + (size_t)size);
+		EncodeString(str, encoding_, &chunk_[offset], (int)size);
+		if (chunk_.size() >= kChunkSize)
+			Flush();
+	}
+
+	bool Flush() {
+		if (!failed_ && !chunk_.empty()) {
+			if (write_(chunk_.data(), (int)chunk_.size(), user_))
+				written_ += chunk_.size();
+			else
+				failed_ = true;
+		}
+		chunk_.clear();
+		return !failed_;
+	}
+
+	bool failed() const { return failed_; }
+	int64_t written() const { return written_; }
+
+private:
+	int encoding_;
+	V8WriteCallback write_;
+	void* user_;
+	std::string chunk_;
+	int64_t written_;
+	bool failed_;
+};
+
+// plain arrays and objects are written member by member, anything whose
+// serialization is not just its members (toJSON, boxed primitives, proxies)
+// goes through a single JSON::Stringify
+static bool IsStreamable(Isolate* isolate, Local<Context> context, Local<Object> obj) {
+	if (obj->IsProxy() || obj->IsFunction() || obj->IsNumberObject() ||
+		obj->IsStringObject() || obj->IsBooleanObject())
+		return false;
+	Local<Value> toJSON;
+	if (!obj->Get(context, LocalStringFromUtf8(isolate, "toJSON")).ToLocal(&toJSON))
+		return false;
+	return !toJSON->IsFunction();
+}
+
+static bool WriteJson(Isolate* isolate, Local<Context> context, Local<Object> obj, JsonStreamWriter& writer) {
+	Local<String> undefined_json = LocalStringFromUtf8(isolate, "undefined");
+
+	if (!IsStreamable(isolate, context, obj)) {
+		Local<String> json;
+		if (!StringifyValue(context, obj, undefined_json, &json))
+			return false;
+		writer.Append(json);
+		return true;
+	}
+
+	if (obj->IsArray()) {
+		auto array = Local<Array>::Cast(obj);
+		uint32_t length = array->Length();
+		writer.Append("[");
+		for (uint32_t i = 0; i < length && !writer.failed(); i++) {
+			HandleScope element_scope(isolate);
+			Local<Value> element;
+			Local<String> json;
+			if (!array->Get(context, i).ToLocal(&element))
+				return false;
+			if (i)
+				writer.Append(",");
+			if (StringifyValue(context, element, undefined_json, &json))
+				writer.Append(json);
+			else if (!json.IsEmpty() || element->IsUndefined() || element->IsFunction() || element->IsSymbol())
+				writer.Append("null");
+			else
+				return false;
+		}
+		writer.Append("]");
+		return true;
+	}
+
+	Local<Array> keys;
+	if (!obj->GetOwnPropertyNames(context).ToLocal(&keys))
+		return false;
+	writer.Append("{");
+	bool first = true;
+	for (uint32_t i = 0; i < keys->Length() && !writer.failed(); i++) {
+		HandleScope member_scope(isolate);
+		Local<Value> key;
+		Local<String> name, quoted, json;
+		Local<Value> value;
+		if (!keys->Get(context, i).ToLocal(&key) || !key->ToString(context).ToLocal(&name) ||
+			!obj->Get(context, name).ToLocal(&value))
+			return false;
+		if (!StringifyValue(context, value, undefined_json, &json)) {
+			if (json.IsEmpty() && !value->IsUndefined() && !value->IsFunction() && !value->IsSymbol())
+				return false;
+			continue;
+		}
+		if (!JSON::Stringify(context, name).ToLocal(&quoted))
+			return false;
+		if (!first)
+			writer.Append(",");
+		writer.Append(quoted);
+		writer.Append(":");
+		writer.Append(json);
+		first = false;
+	}
+	writer.Append("}");
+	return true;
+}
+
+int64_t __stdcall v8_json_write(V8Object _obj, int encoding, V8WriteCallback write, void* user) {
+	V8_EXPORT_SCOPE(v8_json_write);
+	auto obj = (Global<Object>*)_obj;
+	if (!obj || !write)
+		return -1;
+
+	Isolate *isolate = Isolate::GetCurrent();
+	HandleScope handleScope(isolate);
+	auto context = isolate->GetCurrentContext();
+	Local<Object> lobj = Local<Object>::New(isolate, *obj);
+	TryCatch tryCatch(isolate);
+	JsonStreamWriter writer(encoding, write, user);
+
+	bool ok = WriteJson(isolate, context, lobj, writer);
+	if (tryCatch.HasCaught()) {
+		String::Utf8Value exception(tryCatch.Exception());
+		OutputDebugStringA(ToCString(exception));
+	}
+
+	if (!ok || !writer.Flush())
+		return -1;
+	return writer.written();
+}
+
+//
+// Shared regions are process-wide and not tied to an isolate: every isolate
+// that asks for a view gets its own SharedArrayBuffer object over the same
+// externalized memory, so the data exists once however many engines use it.
+//
+enum SharedRegionKind {
+	kRegionMapped,
+	kRegionOwned,
+	kRegionHost
+};
+
+struct SharedRegion {
+	char* data;
+	size_t size;
+	SharedRegionKind kind;
+};
+
+static SharedRegion* MapFile(const uint16_t* filename, bool writable) {
+	void* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file = CreateFileW((LPCWSTR)filename, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0 ||
+		(uint64_t)file_size.QuadPart > (uint64_t)SIZE_MAX) {
+		CloseHandle(file);
+		return nullptr;
+	}
+	size = (size_t)file_size.QuadPart;
+
+	// read-only regions are copy-on-write, a stray store from script gets a
+	// private page instead of an access violation and never reaches the file;
+	// the page is private to the process, not to the isolate, so every engine
+	// viewing the region sees the store
+	HANDLE mapping = CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return nullptr;
+
+	data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+		return nullptr;
+#else
+	int fd = open(NativePath(filename).c_str(), writable ? O_RDWR : O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0 || (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+		close(fd);
+		return nullptr;
+	}
+	size = (size_t)st.st_size;
+
+	// read-only regions are copy-on-write, see above
+	data = mmap(nullptr, size, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return nullptr;
+#endif
+
+	auto region = new SharedRegion();
+	region->data = (char*)data;
+	region->size = size;
+	region->kind = kRegionMapped;
+	return region;
+}
+
+V8SharedRegion __stdcall v8_map_file(const uint16_t* filename, BOOL writable) {
+	V8_EXPORT_SCOPE(v8_map_file);
+	if (!filename)
+		return nullptr;
+
+	SharedRegion* region = MapFile(filename, writable != FALSE);
+	if (!region)
+		OutputDebugStringA("v8_map_file: cannot map file");
+	return region;
+}
+
+V8SharedRegion __stdcall v8_new_shared_region(void* data, int64_t size) {
+	V8_EXPORT_SCOPE(v8_new_shared_region);
+	if (size <= 0 || (uint64_t)size > (uint64_t)SIZE_MAX)
+		return nullptr;
+
+	auto region = new SharedRegion();
+	region->size = (size_t)size;
+	if (data) {
+		region->data = (char*)data;
+		region->kind = kRegionHost;
+	}
+	else {
+		region->data = (char*)calloc(region->size, 1);
+		region->kind = kRegionOwned;
+		if (!region->data) {
+			delete region;
+			return nullptr;
+		}
+	}
+	return region;
+}
+
+void __stdcall v8_destroy_shared_region(V8SharedRegion _region) {
+	V8_EXPORT_SCOPE(v8_destroy_shared_region);
+	auto region = (SharedRegion*)_region;
+	if (!region)
+		return;
+
+	switch (region->kind) {
+	case kRegionMapped:
+#ifdef _WIN32
+		UnmapViewOfFile(region->data);
+#else
+		munmap(region->data, region->size);
+#endif
+		break;
+
+	case kRegionOwned:
+		free(region->data);
+		break;
+
+	case kRegionHost:
+		break;
+	}
+	delete region;
+}
+
+void* __stdcall v8_shared_region_data(V8SharedRegion _region, int64_t* size) {
+	V8_EXPORT_SCOPE(v8_shared_region_data);
+	auto region = (SharedRegion*)_region;
+	if (!region)
+		return nullptr;
+	if (size)
+		*size = (int64_t)region->size;
+	return region->data;
+}
+
+static int ViewElementSize(int type) {
+	switch (type) {
+	case V8_VIEW_BUFFER:
+	case V8_VIEW_INT8:
+	case V8_VIEW_UINT8:
+		return 1;
+	case V8_VIEW_INT16:
+	case V8_VIEW_UINT16:
+		return 2;
+	case V8_VIEW_INT32:
+	case V8_VIEW_UINT32:
+	case V8_VIEW_FLOAT32:
+		return 4;
+	case V8_VIEW_FLOAT64:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static Local<Object> NewView(Local<SharedArrayBuffer> buffer, int type, size_t count) {
+	switch (type) {
+	case V8_VIEW_INT8:
+		return Int8Array::New(buffer, 0, count);
+	case V8_VIEW_UINT8:
+		return Uint8Array::New(buffer, 0, count);
+	case V8_VIEW_INT16:
+		return Int16Array::New(buffer, 0, count);
+	case V8_VIEW_UINT16:
+		return Uint16Array::New(buffer, 0, count);
+	case V8_VIEW_INT32:
+		return Int32Array::New(buffer, 0, count);
+	case V8_VIEW_UINT32:
+		return Uint32Array::New(buffer, 0, count);
+	case V8_VIEW_FLOAT32:
+		return Float32Array::New(buffer, 0, count);
+	case V8_VIEW_FLOAT64:
+		return Float64Array::New(buffer, 0, count);
+	default:
+		return buffer;
+	}
+}
+
+V8Object __stdcall v8_shared_region_view(V8Isolate _isolate, V8Context _context, V8SharedRegion _region,
+	int64_t offset, int64_t length, int type) {
+	V8_EXPORT_SCOPE(v8_shared_region_view);
+	auto isolate = (Isolate*)_isolate;
+	auto context = (Global<Context>*)_context;
+	auto region = (SharedRegion*)_region;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	int element_size = ViewElementSize(type);
+	if (!isolate || !region || !element_size)
+		return nullptr;
+
+	if (length < 0)
+		length = (int64_t)region->size - offset;
+
+	// typed arrays need element-aligned data, mapped and calloc'ed regions
+	// are aligned so this comes down to the offset
+	if (offset < 0 || length < 0 || (uint64_t)(offset + length) > (uint64_t)region->size ||
+		offset % element_size || length % element_size ||
+		(uintptr_t)(region->data + offset) % element_size) {
+		OutputDebugStringA("v8_shared_region_view: range out of bounds or misaligned");
+		return nullptr;
+	}
+
+	HandleScope handle_scope(isolate);
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+	Context::Scope context_scope(lcontext);
+
+	// externalized, V8 never frees the memory, the host destroys the region
+	// after every isolate holding a view has been disposed
+	auto buffer = SharedArrayBuffer::New(isolate, region->data + offset, (size_t)length,
+		ArrayBufferCreationMode::kExternalized);
+	return NewGlobalHandle(isolate, NewView(buffer, type, (size_t)length / element_size));
+}
+
+//
+// Streaming compilation: the host feeds the source in chunks from any thread
+// while V8 scans and parses them on a background thread, then compiles and
+// runs the result on the isolate's thread once the last chunk has arrived.
+//
+class HostSourceStream : public ScriptCompiler::ExternalSourceStream {
+public:
+	HostSourceStream() : ended_(false) {}
+
+	~HostSourceStream() {
+		for (auto& chunk : chunks_)
+			delete[] chunk.first;
+	}
+
+	// runs on the parser thread, blocks until the host feeds more or ends
+	virtual size_t GetMoreData(const uint8_t** src) {
+		std::unique_lock<std::mutex> lock(lock_);
+		ready_.wait(lock, [this] { return !chunks_.empty() || ended_; });
+		if (chunks_.empty()) {
+			*src = nullptr;
+			return 0;
+		}
+		auto chunk = chunks_.front();
+		chunks_.pop_front();
+		*src = chunk.first;
+		return chunk.second;
+	}
+
+	// takes ownership of data, which V8 releases with delete[]
+	void Push(uint8_t* data, size_t size) {
+		std::lock_guard<std::mutex> lock(lock_);
+		chunks_.push_back(std::make_pair(data, size));
+		ready_.notify_one();
+	}
+
+	void End() {
+		std::lock_guard<std::mutex> lock(lock_);
+		ended_ = true;
+		ready_.notify_one();
+	}
+
+private:
+	std::mutex lock_;
+	std::condition_variable ready_;
+	std::deque<std::pair<uint8_t*, size_t>> chunks_;
+	bool ended_;
+};
+
+struct ScriptStream {
+	Isolate* isolate;
+	int encoding;
+	std::u16string name;
+	HostSourceStream* stream; // owned by source
+	std::unique_ptr<ScriptCompiler::StreamedSource> source;
+	std::unique_ptr<ScriptCompiler::ScriptStreamingTask> task;
+	std::thread parser;
+
+	// Compile still needs the complete text, for Function.prototype.toString
+	// and lazily compiled functions, and V8 takes ownership of (and frees) the
+	// chunks it is handed, so the source has to be kept here as well; the
+	// chunks are released as the parser consumes them, which leaves this copy
+	std::mutex feed_lock;
+	std::string utf8;
+	std::u16string utf16;
+	size_t pushed;
+	bool ended;
+	bool ran;
+};
+
+// V8 copes with a UTF-8 character split across two chunks but not three,
+// so tiny UTF-8 chunks are held back until at least 4 bytes are pending
+static const size_t kMinUtf8Chunk = 4;
+
+static void PushPending(ScriptStream* script, bool force) {
+	size_t size = script->encoding == V8_UTF16
+		? (script->utf16.size() - script->pushed) * sizeof(uint16_t)
+		: script->utf8.size() - script->pushed;
+	if (size == 0 || (!force && script->encoding != V8_UTF16 && size < kMinUtf8Chunk))
+		return;
+
+	auto chunk = new uint8_t[size];
+	if (script->encoding == V8_UTF16) {
+		memcpy(chunk, script->utf16.data() + script->pushed, size);
+		script->pushed = script->utf16.size();
+	}
+	else {
+		memcpy(chunk, script->utf8.data() + script->pushed, size);
+		script->pushed = script->utf8.size();
+	}
+	script->stream->Push(chunk, size);
+}
+
+static void EndStream(ScriptStream* script) {
+	{
+		std::lock_guard<std::mutex> lock(script->feed_lock);
+		if (script->ended)
+			return;
+		PushPending(script, true);
+		script->ended = true;
+	}
+	script->stream->End();
+	script->parser.join();
+}
+
+V8ScriptStream __stdcall v8_new_script_stream(V8Isolate _isolate, int encoding, const uint16_t* name) {
+	V8_EXPORT_SCOPE(v8_new_script_stream);
+	auto isolate = (Isolate*)_isolate;
+	if (!isolate)
+		isolate = Isolate::GetCurrent();
+
+	if (!isolate || (encoding != V8_UTF8 && encoding != V8_UTF16))
+		return nullptr;
+
+	auto script = new ScriptStream();
+	script->isolate = isolate;
+	script->encoding = encoding;
+	if (name)
+		script->name = (const char16_t*)name;
+	script->stream = new HostSourceStream();
+	script->source.reset(new ScriptCompiler::StreamedSource(script->stream,
+		encoding == V8_UTF16 ? ScriptCompiler::StreamedSource::TWO_BYTE : ScriptCompiler::StreamedSource::UTF8));
+	script->pushed = 0;
+	script->ended = false;
+	script->ran = false;
+
+	Isolate::Scope isolate_scope(isolate);
+	script->task.reset(ScriptCompiler::StartStreamingScript(isolate, script->source.get()));
+	ScriptCompiler::ScriptStreamingTask* task = script->task.get();
+	script->parser = std::thread([task] { task->Run(); });
+	return script;
+}
+
+BOOL __stdcall v8_script_stream_feed(V8ScriptStream _script, const void* data, int length) {
+	V8_EXPORT_SCOPE(v8_script_stream_feed);
+	auto script = (ScriptStream*)_script;
+	if (!script || length < 0 || (length && !data))
+		return FALSE;
+
+	std::lock_guard<std::mutex> lock(script->feed_lock);
+	if (script->ended)
+		return FALSE;
+
+	if (script->encoding == V8_UTF16)
+		script->utf16.append((const char16_t*)data, length);
+	else
+		script->utf8.append((const char*)data, length);
+	PushPending(script, false);
+	return TRUE;
+}
+
+V8String __stdcall v8_script_stream_run(V8ScriptStream _script, V8Context _context) {
+	V8_EXPORT_SCOPE(v8_script_stream_run);
+	auto script = (ScriptStream*)_script;
+	auto context = (Global<Context>*)_context;
+	if (!script)
+		return nullptr;
+
+	// the StreamedSource is spent by the first Compile
+	if (script->ran) {
+		OutputDebugStringA("v8_script_stream_run: stream already ran");
+		return nullptr;
+	}
+	script->ran = true;
+
+	// waits for the background parse of everything fed so far
+	EndStream(script);
+
+	Isolate* isolate = script->isolate;
+	HandleScope handle_scope(isolate);
+
+	Local<Context> lcontext;
+
+	if (context)
+		lcontext = Local<Context>::New(isolate, *context);
+	else
+		lcontext = isolate->GetCurrentContext();
+
+	Context::Scope context_scope(lcontext);
+	TryCatch tryCatch(isolate);
+
+	MaybeLocal<String> full_source;
+	if (script->encoding == V8_UTF16)
+		full_source = String::NewFromTwoByte(isolate, (const uint16_t*)script->utf16.data(),
+			NewStringType::kNormal, (int)script->utf16.size());
+	else
+		full_source = String::NewFromUtf8(isolate, script->utf8.data(),
+			NewStringType::kNormal, (int)script->utf8.size());
+
+	if (full_source.IsEmpty()) {
+		OutputDebugStringA("v8_script_stream_run: source exceeds the maximum string length");
+		return nullptr;
+	}
+
+	ScriptOrigin origin(LocalString(isolate, script->name.c_str()));
+	MaybeLocal<Script> compiled = ScriptCompiler::Compile(lcontext, script->source.get(),
+		CountInputString(full_source.ToLocalChecked()), origin);
+
+	if (compiled.IsEmpty())
+	{
+		OutputDebugStringA("Compile error");
+		ReportException(isolate, &tryCatch);
+		return ExceptionString(&tryCatch);
+	}
+
+	MaybeLocal<Value> result = compiled.ToLocalChecked()->Run(lcontext);
+
+	if (result.IsEmpty())
+	{
+		OutputDebugStringA("Run error");
+		ReportException(isolate, &tryCatch);
+		return ExceptionString(&tryCatch);
+	}
+
+	auto lresult = result.ToLocalChecked();
+	return (V8String)v8_val_to_string(&lresult);
+}
+
+void __stdcall v8_destroy_script_stream(V8ScriptStream _script) {
+	V8_EXPORT_SCOPE(v8_destroy_script_stream);
+	auto script = (ScriptStream*)_script;
+	if (!script)
+		return;
+
+	// not cancellable, the parser finishes what was fed before it returns
+	EndStream(script);
+	script->task.reset();
+	script->source.reset();
+	delete script;
 }
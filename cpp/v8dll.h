@@ -1,5 +1,14 @@
 #pragma once
+#include <stdint.h>
+
+#ifdef _WIN32
 #include "windows.h"
+#else
+typedef int BOOL;
+#define TRUE 1
+#define FALSE 0
+#define __stdcall
+#endif
 
 #define V8_ERROR 0
 #define V8_RANGE_ERROR 1
@@ -7,14 +16,63 @@
 #define V8_SYNTAX_ERROR 3
 #define V8_TYPE_ERROR 4
 
+#define V8_VALUE_UNDEFINED 0
+#define V8_VALUE_NULL 1
+#define V8_VALUE_BOOL 2
+#define V8_VALUE_INT32 3
+#define V8_VALUE_FLOAT 4
+#define V8_VALUE_STRING 5
+#define V8_VALUE_OBJECT 6
+
+#define V8_UTF8 0
+#define V8_UTF16 1
+
+#define V8_VIEW_BUFFER 0
+#define V8_VIEW_INT8 1
+#define V8_VIEW_UINT8 2
+#define V8_VIEW_INT16 3
+#define V8_VIEW_UINT16 4
+#define V8_VIEW_INT32 5
+#define V8_VIEW_UINT32 6
+#define V8_VIEW_FLOAT32 7
+#define V8_VIEW_FLOAT64 8
+
 typedef void* V8Isolate;
 typedef void* V8Context;
 typedef void* V8String;
 typedef void* V8Object;
 typedef void* V8ObjectTemplate;
 typedef void* V8FunctionCallbackInfo;
+typedef void* V8Class;
+typedef void* V8SharedRegion;
+typedef void* V8ScriptStream;
 
 typedef void(*V8FunctionCallback)(V8FunctionCallbackInfo info);
+typedef void*(*V8ClassConstructor)(V8FunctionCallbackInfo info, void* data);
+typedef void(*V8ClassFinalizer)(void* instance, void* data);
+
+typedef struct {
+	int32_t type;
+	union {
+		BOOL b;
+		int32_t i;
+		double f;
+		const uint16_t* s;
+		V8Object o;
+	};
+} V8TaggedValue;
+
+// host-owned output buffer, grow must reallocate data to at least capacity
+// bytes and update capacity, or return FALSE to leave it as it is
+typedef struct V8Buffer {
+	char* data;
+	int size;
+	int capacity;
+	BOOL(*grow)(struct V8Buffer* buffer, int capacity);
+	void* user;
+} V8Buffer;
+
+typedef BOOL(*V8WriteCallback)(const void* data, int size, void* user);
 
 BOOL __stdcall v8_init();
 void __stdcall v8_cleanup();
@@ -92,6 +150,116 @@ BOOL __stdcall v8_object_get_int64_field(V8Object _obj, const uint16_t* name, in
 V8String __stdcall v8_object_get_string_field(V8Object _obj, const uint16_t* name);
 V8Object __stdcall v8_object_get_object_field(V8Object _obj, const uint16_t* name);
 
+//
+// Export instrumentation, only functional when built with V8DLL_METRICS.
+// v8_enable_metrics returns the previous state (always FALSE when compiled out).
+// v8_get_metrics writes a null-terminated JSON snapshot into buffer if size is
+// large enough and returns its length without the terminator, or 0 when
+// compiled out; call it with a null buffer to query the required size.
+//
+BOOL __stdcall v8_enable_metrics(BOOL enable);
+void __stdcall v8_reset_metrics();
+int __stdcall v8_get_metrics(char* buffer, int size);
+
+//
+// Arrays. v8_new_*_array create an Array, or with typed a typed array, from a
+// native buffer. v8_array_get_* copy elements [start, start + count) into a
+// native buffer and return the number copied, or -1; int32/float reads copy
+// typed arrays of the same type directly and Arrays with packed number
+// elements in bulk in contexts from v8_new_context, other array-likes one
+// element at a time.
+//
+V8Object __stdcall v8_new_int32_array(V8Isolate, V8Context, const int32_t* data, int count, BOOL typed);
+V8Object __stdcall v8_new_float_array(V8Isolate, V8Context, const double* data, int count, BOOL typed);
+V8Object __stdcall v8_new_string_array(V8Isolate, V8Context, const uint16_t* const* data, int count);
+V8Object __stdcall v8_new_array_from_values(V8Isolate, V8Context, const V8TaggedValue* values, int count);
+int __stdcall v8_array_length(V8Object obj);
+int __stdcall v8_array_get_int32(V8Object obj, int start, int32_t* buffer, int count);
+int __stdcall v8_array_get_float(V8Object obj, int start, double* buffer, int count);
+int __stdcall v8_array_get_strings(V8Object obj, int start, V8String* buffer, int count);
+
+//
+// Class binding. JS "new Name(...)" calls constructor, whose non-null result is
+// stored in internal field 0. If finalizer is set it is called once the JS
+// wrapper is garbage collected (never for wrappers alive at isolate disposal).
+// Set the class up in order: v8_class_add_method, v8_class_inherit, then
+// v8_class_install or v8_class_new_instance; once either of those has run the
+// class and its parents are fixed and add_method/inherit return FALSE.
+// After v8_destroy_class an installed constructor throws "Illegal constructor",
+// existing instances are still finalized; the class memory is released with
+// the isolate, so destroy classes before destroying their isolate.
+//
+V8Class __stdcall v8_new_class(V8Isolate, const char* name, int InternalFieldCount,
+	V8ClassConstructor constructor, V8ClassFinalizer finalizer, const void* data);
+void __stdcall v8_destroy_class(V8Class cls);
+BOOL __stdcall v8_class_add_method(V8Class cls, const char* name, V8FunctionCallback func, const void* data);
+BOOL __stdcall v8_class_inherit(V8Class cls, V8Class parent);
+BOOL __stdcall v8_class_install(V8Isolate, V8Context, V8Class cls);
+V8Object __stdcall v8_class_new_instance(V8Isolate, V8Context, V8Class cls, void* FirstInternalField);
+
+//
+// DevTools inspector, only functional when built with V8DLL_INSPECTOR (start
+// returns FALSE and poll -1 otherwise). Call all three on the isolate's thread.
+// v8_inspector_start listens on 127.0.0.1:port; with waitForDebugger it blocks
+// until a client attaches and resumes. The host calls v8_inspector_poll while
+// no script is running to dispatch pending protocol messages; it returns the
+// number dispatched, or -1 when no inspector is started for the isolate.
+// v8_write_heap_snapshot writes a .heapsnapshot file DevTools can load, via
+// "<filename>.tmp" so that filename is only replaced by a complete snapshot.
+//
+BOOL __stdcall v8_inspector_start(V8Isolate, V8Context, int port, BOOL waitForDebugger);
+void __stdcall v8_inspector_stop(V8Isolate);
+int __stdcall v8_inspector_poll(V8Isolate);
+BOOL __stdcall v8_write_heap_snapshot(V8Isolate, const uint16_t* filename);
 
+//
+// JSON without going through the script compiler. v8_json_parse takes UTF-8
+// (V8_UTF8, length in bytes) or UTF-16 (V8_UTF16, length in chars) text, -1
+// for null-terminated, and returns nullptr for invalid JSON or "null".
+// v8_json_stringify writes the document in the requested encoding, without a
+// terminator, into buffer, growing it if needed; it returns the size in bytes,
+// larger than buffer->capacity if it did not fit, or -1 on failure.
+// v8_json_write streams compact JSON to write in chunks of about 64KB, one
+// array element or object member at a time so that documents larger than a
+// single V8 string can be produced; it returns the bytes written or -1.
+//
+V8Object __stdcall v8_json_parse(V8Isolate, V8Context, const void* json, int length, int encoding);
+int __stdcall v8_json_stringify(V8Object obj, const uint16_t* gap, int encoding, V8Buffer* buffer);
+int64_t __stdcall v8_json_write(V8Object obj, int encoding, V8WriteCallback write, void* user);
 
+//
+// Shared memory regions, viewed from any number of isolates as a
+// SharedArrayBuffer (V8_VIEW_BUFFER) or a typed array over it without copying.
+// v8_map_file maps a whole file: read-only regions are copy-on-write and never
+// change the file, but the copied pages are shared by all isolates of the
+// process, so a store from one script is seen by every engine viewing the
+// region; writable ones write through to the file. v8_new_shared_region
+// wraps host memory, or allocates zeroed memory when data is null. Script
+// updates the data in place with Atomics on integer views; the host does the
+// same with interlocked operations on aligned values from
+// v8_shared_region_data. A region must outlive every isolate that has a view
+// of it. Views take a byte range, length -1 means to the end of the region.
+//
+V8SharedRegion __stdcall v8_map_file(const uint16_t* filename, BOOL writable);
+V8SharedRegion __stdcall v8_new_shared_region(void* data, int64_t size);
+void __stdcall v8_destroy_shared_region(V8SharedRegion region);
+void* __stdcall v8_shared_region_data(V8SharedRegion region, int64_t* size);
+V8Object __stdcall v8_shared_region_view(V8Isolate, V8Context, V8SharedRegion region,
+	int64_t offset, int64_t length, int type);
 
+//
+// Streaming compilation. Create the stream on the isolate's thread with the
+// encoding of the chunks (V8_UTF8, length in bytes, or V8_UTF16, length in
+// chars) and an optional script name, then feed chunks from any thread as they
+// arrive; V8 parses them on a background thread meanwhile. v8_script_stream_run
+// ends the input, compiles and runs the script on the isolate's thread and
+// returns its result or exception like v8_eval_asstr; a stream runs once, a
+// second v8_script_stream_run returns nullptr. Destroying a stream that has not
+// been run ends its input and blocks until the background parse of what was
+// fed has finished, it does not interrupt the parse. The stream keeps a copy of
+// all the source fed until it is destroyed.
+//
+V8ScriptStream __stdcall v8_new_script_stream(V8Isolate, int encoding, const uint16_t* name);
+BOOL __stdcall v8_script_stream_feed(V8ScriptStream stream, const void* data, int length);
+V8String __stdcall v8_script_stream_run(V8ScriptStream stream, V8Context);
+void __stdcall v8_destroy_script_stream(V8ScriptStream stream);
@@ -0,0 +1,685 @@
+#include "stdafx.h"
+
+#ifdef V8DLL_INSPECTOR
+
+// winsock2.h has to come before windows.h, which v8dll.h pulls in
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET socket_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include <ctype.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <include/v8-inspector.h>
+
+#include "v8dll.h"
+#include "v8inspector.h"
+
+using namespace v8;
+using v8_inspector::StringBuffer;
+using v8_inspector::StringView;
+using v8_inspector::V8ContextInfo;
+using v8_inspector::V8Inspector;
+using v8_inspector::V8InspectorClient;
+using v8_inspector::V8InspectorSession;
+
+namespace v8dll_inspector {
+
+const int kContextGroupId = 1;
+
+//
+// protocol text helpers: the socket speaks UTF-8, StringView is Latin-1 or UTF-16
+//
+
+static std::u16string Utf8ToUtf16(const std::string& s) {
+	std::u16string out;
+	out.reserve(s.size());
+	for (size_t i = 0; i < s.size();) {
+		uint32_t c = (uint8_t)s[i];
+		int extra = c < 0x80 ? 0 : c < 0xE0 ? 1 : c < 0xF0 ? 2 : 3;
+		if (extra)
+			c &= 0x3F >> extra;
+		if (i + extra >= s.size())
+			break;
+		for (int k = 1; k <= extra; k++)
+			c = (c << 6) | ((uint8_t)s[i + k] & 0x3F);
+		i += extra + 1;
+		if (c >= 0x10000) {
+			c -= 0x10000;
+			out += (char16_t)(0xD800 + (c >> 10));
+			out += (char16_t)(0xDC00 + (c & 0x3FF));
+		}
+		else
+			out += (char16_t)c;
+	}
+	return out;
+}
+
+static std::string ToUtf8(const StringView& view) {
+	if (!view.is8Bit())
+		return Utf16ToUtf8(view.characters16(), view.length());
+	// Latin-1, every character is below U+0100
+	std::string out;
+	out.reserve(view.length());
+	for (size_t i = 0; i < view.length(); i++) {
+		uint8_t c = view.characters8()[i];
+		if (c < 0x80)
+			out += (char)c;
+		else {
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return out;
+}
+
+//
+// WebSocket handshake: base64(sha1(key + GUID))
+//
+
+static std::string Sha1(const std::string& input) {
+	uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	std::string msg = input;
+	uint64_t bits = (uint64_t)input.size() * 8;
+	msg += (char)0x80;
+	while (msg.size() % 64 != 56)
+		msg += (char)0;
+	for (int i = 7; i >= 0; i--)
+		msg += (char)(bits >> (i * 8));
+
+	for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++)
+			w[i] = ((uint32_t)(uint8_t)msg[chunk + i * 4] << 24) | ((uint32_t)(uint8_t)msg[chunk + i * 4 + 1] << 16) |
+				((uint32_t)(uint8_t)msg[chunk + i * 4 + 2] << 8) | (uint32_t)(uint8_t)msg[chunk + i * 4 + 3];
+		for (int i = 16; i < 80; i++) {
+			uint32_t v = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+			w[i] = (v << 1) | (v >> 31);
+		}
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; i++) {
+			uint32_t f, k;
+			if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+			else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+			else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+			else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+			uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+			e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+	}
+
+	std::string digest;
+	for (int i = 0; i < 5; i++)
+		for (int j = 3; j >= 0; j--)
+			digest += (char)(h[i] >> (j * 8));
+	return digest;
+}
+
+static std::string Base64(const std::string& data) {
+	static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+	for (size_t i = 0; i < data.size(); i += 3) {
+		uint32_t v = (uint32_t)(uint8_t)data[i] << 16;
+		if (i + 1 < data.size()) v |= (uint32_t)(uint8_t)data[i + 1] << 8;
+		if (i + 2 < data.size()) v |= (uint32_t)(uint8_t)data[i + 2];
+		out += table[(v >> 18) & 63];
+		out += table[(v >> 12) & 63];
+		out += i + 1 < data.size() ? table[(v >> 6) & 63] : '=';
+		out += i + 2 < data.size() ? table[v & 63] : '=';
+	}
+	return out;
+}
+
+static bool SendAll(socket_t s, const char* data, size_t size) {
+	while (size > 0) {
+		int n = send(s, data, (int)std::min<size_t>(size, 1 << 20), 0);
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool RecvAll(socket_t s, char* data, size_t size) {
+	while (size > 0) {
+		int n = recv(s, data, (int)std::min<size_t>(size, 1 << 20), 0);
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+//
+// HTTP request checks. Any page the user has open in a browser can open a
+// WebSocket to 127.0.0.1 and, through DNS rebinding, fetch /json, so as in
+// node the target id is random, the Host must name the loopback address and
+// an upgrade must come from DevTools rather than a web origin.
+//
+
+// a random id in UUID form, new for every Start
+static std::string NewTargetId() {
+	std::random_device random;
+	char buf[40];
+	uint32_t a = random(), b = random(), c = random(), d = random();
+	snprintf(buf, sizeof(buf), "%08x-%04x-%04x-%04x-%04x%08x",
+		a, b >> 16, b & 0xFFFF, c >> 16, c & 0xFFFF, d);
+	return buf;
+}
+
+// trimmed value of a request header, empty if absent; name is looked up in
+// the lowercased copy of the request and the value taken from request
+static std::string HeaderValue(const std::string& request, const std::string& lower_request, const char* name) {
+	std::string field = std::string("\r\n") + name + ":";
+	size_t start = lower_request.find(field);
+	if (start == std::string::npos)
+		return std::string();
+	start += field.size();
+	size_t end = lower_request.find("\r\n", start);
+	std::string value = request.substr(start, end - start);
+	value.erase(0, value.find_first_not_of(" \t"));
+	value.erase(value.find_last_not_of(" \t") + 1);
+	return value;
+}
+
+// the request line's target, "/json" from "GET /json HTTP/1.1"
+static std::string RequestPath(const std::string& request) {
+	if (request.compare(0, 4, "GET ") != 0)
+		return std::string();
+	size_t end = request.find(' ', 4);
+	return end == std::string::npos ? std::string() : request.substr(4, end - 4);
+}
+
+static bool IsLoopbackHost(const std::string& host, int port) {
+	std::string suffix = ":" + std::to_string(port);
+	return host == "127.0.0.1" + suffix || host == "localhost" + suffix;
+}
+
+// DevTools sends no Origin, or one of its own; a page sends its web origin
+static bool IsDevToolsOrigin(const std::string& origin) {
+	return origin.empty() || origin.compare(0, 11, "devtools://") == 0 ||
+		origin.compare(0, 18, "chrome-devtools://") == 0;
+}
+
+//
+// One agent per isolate: a socket thread feeding an event queue, drained on
+// the isolate's thread into a V8InspectorSession.
+//
+
+class Agent : public V8InspectorClient, public V8Inspector::Channel {
+public:
+	Agent(Isolate* isolate, Local<Context> context, int port)
+		: isolate_(isolate), context_(isolate, context), port_(port), id_(NewTargetId()),
+		listener_(INVALID_SOCKET), client_(INVALID_SOCKET),
+		stopping_(false), paused_(false), waiting_(false) {
+		inspector_ = V8Inspector::create(isolate, this);
+		const char name[] = "v8dll";
+		inspector_->contextCreated(V8ContextInfo(context, kContextGroupId,
+			StringView((const uint8_t*)name, sizeof(name) - 1)));
+	}
+
+	~Agent() {
+		StopServer();
+		session_.reset();
+		HandleScope handle_scope(isolate_);
+		inspector_->contextDestroyed(Local<Context>::New(isolate_, context_));
+		inspector_.reset();
+	}
+
+	bool StartServer() {
+		listener_ = socket(AF_INET, SOCK_STREAM, 0);
+		if (listener_ == INVALID_SOCKET)
+			return false;
+
+		int reuse = 1;
+		setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons((uint16_t)port_);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if (bind(listener_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener_, 1) != 0) {
+			closesocket(listener_);
+			listener_ = INVALID_SOCKET;
+			return false;
+		}
+
+		char buf[128];
+		snprintf(buf, sizeof(buf), "inspector listening on ws://127.0.0.1:%d/%s\n", port_, id_.c_str());
+		OutputDebugStringA(buf);
+		thread_ = std::thread(&Agent::ServerLoop, this);
+		return true;
+	}
+
+	// blocks until a client sends Runtime.runIfWaitingForDebugger
+	void WaitForDebugger() {
+		waiting_ = true;
+		while (waiting_ && WaitForEvent())
+			DispatchPending();
+	}
+
+	int DispatchPending() {
+		int count = 0;
+		Event event;
+		// one at a time: a message may pause and re-enter through the pause loop
+		while (PopEvent(&event)) {
+			count++;
+			switch (event.type) {
+			case Event::kConnect:
+				session_ = inspector_->connect(kContextGroupId, this, StringView());
+				break;
+
+			case Event::kDisconnect:
+				session_.reset();
+				paused_ = false;
+				waiting_ = false;
+				break;
+
+			case Event::kMessage:
+				if (session_) {
+					std::u16string message = Utf8ToUtf16(event.text);
+					session_->dispatchProtocolMessage(
+						StringView((const uint16_t*)message.data(), message.size()));
+				}
+				break;
+			}
+		}
+		return count;
+	}
+
+	static void OnInterrupt(Isolate* isolate, void*);
+
+	// V8InspectorClient
+
+	void runMessageLoopOnPause(int) override {
+		paused_ = true;
+		while (paused_ && WaitForEvent())
+			DispatchPending();
+	}
+
+	void quitMessageLoopOnPause() override {
+		paused_ = false;
+	}
+
+	void runIfWaitingForDebugger(int) override {
+		waiting_ = false;
+	}
+
+	Local<Context> ensureDefaultContextInGroup(int) override {
+		return Local<Context>::New(isolate_, context_);
+	}
+
+	double currentTimeMS() override {
+		return (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	// V8Inspector::Channel, always called on the isolate's thread
+
+	void sendResponse(int, std::unique_ptr<StringBuffer> message) override {
+		SendText(ToUtf8(message->string()));
+	}
+
+	void sendNotification(std::unique_ptr<StringBuffer> message) override {
+		SendText(ToUtf8(message->string()));
+	}
+
+	void flushProtocolNotifications() override {}
+
+private:
+	struct Event {
+		enum Type { kConnect, kDisconnect, kMessage } type;
+		std::string text;
+	};
+
+	void PushEvent(Event::Type type, const std::string& text = std::string()) {
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			events_.push_back(Event{ type, text });
+		}
+		wakeup_.notify_one();
+		// reaches the isolate even while script is running
+		isolate_->RequestInterrupt(OnInterrupt, nullptr);
+	}
+
+	bool PopEvent(Event* event) {
+		std::lock_guard<std::mutex> lock(lock_);
+		if (events_.empty())
+			return false;
+		*event = std::move(events_.front());
+		events_.pop_front();
+		return true;
+	}
+
+	// false once the agent is stopping
+	bool WaitForEvent() {
+		std::unique_lock<std::mutex> lock(lock_);
+		wakeup_.wait(lock, [this] { return stopping_ || !events_.empty(); });
+		return !stopping_;
+	}
+
+	void SendText(const std::string& text) {
+		std::lock_guard<std::mutex> lock(send_lock_);
+		if (client_ == INVALID_SOCKET)
+			return;
+
+		// server frames are unmasked; FIN + text opcode
+		char header[10];
+		size_t len = text.size(), header_size;
+		header[0] = (char)0x81;
+		if (len < 126) {
+			header[1] = (char)len;
+			header_size = 2;
+		}
+		else if (len < 65536) {
+			header[1] = 126;
+			header[2] = (char)(len >> 8);
+			header[3] = (char)len;
+			header_size = 4;
+		}
+		else {
+			header[1] = 127;
+			for (int i = 0; i < 8; i++)
+				header[2 + i] = (char)((uint64_t)len >> (56 - i * 8));
+			header_size = 10;
+		}
+		if (SendAll(client_, header, header_size))
+			SendAll(client_, text.data(), len);
+	}
+
+	void SendHttp(socket_t s, const char* status, const std::string& body) {
+		char header[256];
+		snprintf(header, sizeof(header),
+			"HTTP/1.1 %s\r\nContent-Type: application/json; charset=UTF-8\r\n"
+			"Content-Length: %d\r\nConnection: close\r\n\r\n", status, (int)body.size());
+		if (SendAll(s, header, strlen(header)))
+			SendAll(s, body.data(), body.size());
+	}
+
+	// answers the /json discovery requests, returns true after a WebSocket upgrade
+	bool Handshake(socket_t s) {
+		std::string request;
+		char c;
+		while (request.size() < 8192 && recv(s, &c, 1, 0) == 1) {
+			request += c;
+			if (request.size() >= 4 && request.compare(request.size() - 4, 4, "\r\n\r\n") == 0)
+				break;
+		}
+
+		std::string lower = request;
+		std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+		std::string path = RequestPath(request);
+
+		if (!IsLoopbackHost(HeaderValue(lower, lower, "host"), port_)) {
+			SendHttp(s, "403 Forbidden", "");
+			return false;
+		}
+
+		std::string key = HeaderValue(request, lower, "sec-websocket-key");
+		if (key.empty()) {
+			char buf[640];
+			if (path == "/json/version") {
+				SendHttp(s, "200 OK", "{\"Browser\":\"v8dll\",\"Protocol-Version\":\"1.3\"}");
+			}
+			else if (path == "/json" || path == "/json/list") {
+				snprintf(buf, sizeof(buf),
+					"[{\"description\":\"v8dll engine\",\"id\":\"%s\",\"title\":\"v8dll\",\"type\":\"node\",\"url\":\"\","
+					"\"devtoolsFrontendUrl\":\"devtools://devtools/bundled/js_app.html?experiments=true&v8only=true&ws=127.0.0.1:%d/%s\","
+					"\"webSocketDebuggerUrl\":\"ws://127.0.0.1:%d/%s\"}]",
+					id_.c_str(), port_, id_.c_str(), port_, id_.c_str());
+				SendHttp(s, "200 OK", buf);
+			}
+			else
+				SendHttp(s, "404 Not Found", "");
+			return false;
+		}
+
+		if (path != "/" + id_) {
+			SendHttp(s, "404 Not Found", "");
+			return false;
+		}
+
+		if (!IsDevToolsOrigin(HeaderValue(lower, lower, "origin"))) {
+			SendHttp(s, "403 Forbidden", "");
+			return false;
+		}
+
+		std::string response =
+			"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: " + Base64(Sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11")) + "\r\n\r\n";
+		return SendAll(s, response.data(), response.size());
+	}
+
+	// reads one complete (possibly fragmented) text message, false on close or error
+	bool ReadMessage(socket_t s, std::string* message) {
+		message->clear();
+		for (;;) {
+			unsigned char header[2];
+			if (!RecvAll(s, (char*)header, 2))
+				return false;
+
+			bool fin = (header[0] & 0x80) != 0;
+			int opcode = header[0] & 0x0F;
+			uint64_t len = header[1] & 0x7F;
+
+			if (len == 126) {
+				unsigned char ext[2];
+				if (!RecvAll(s, (char*)ext, 2))
+					return false;
+				len = ((uint64_t)ext[0] << 8) | ext[1];
+			}
+			else if (len == 127) {
+				unsigned char ext[8];
+				if (!RecvAll(s, (char*)ext, 8))
+					return false;
+				len = 0;
+				for (int i = 0; i < 8; i++)
+					len = (len << 8) | ext[i];
+			}
+
+			// clients must mask, and nothing legitimate is near this size
+			if (!(header[1] & 0x80) || len > ((uint64_t)1 << 31))
+				return false;
+
+			unsigned char mask[4];
+			if (!RecvAll(s, (char*)mask, 4))
+				return false;
+
+			std::string payload((size_t)len, '\0');
+			if (len && !RecvAll(s, &payload[0], (size_t)len))
+				return false;
+			for (size_t i = 0; i < payload.size(); i++)
+				payload[i] ^= mask[i & 3];
+
+			if (opcode == 0x8)
+				return false;
+
+			if (opcode == 0x9) {
+				std::lock_guard<std::mutex> lock(send_lock_);
+				std::string pong;
+				pong += (char)0x8A;
+				pong += (char)std::min<size_t>(payload.size(), 125);
+				pong.append(payload, 0, 125);
+				SendAll(s, pong.data(), pong.size());
+				continue;
+			}
+
+			if (opcode == 0xA)
+				continue;
+
+			*message += payload;
+			if (fin)
+				return true;
+		}
+	}
+
+	void ServerLoop() {
+		while (!stopping_) {
+			socket_t s = accept(listener_, nullptr, nullptr);
+			if (s == INVALID_SOCKET)
+				break;
+
+			if (!Handshake(s)) {
+				closesocket(s);
+				continue;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(send_lock_);
+				client_ = s;
+			}
+			PushEvent(Event::kConnect);
+
+			std::string message;
+			while (!stopping_ && ReadMessage(s, &message))
+				PushEvent(Event::kMessage, message);
+
+			{
+				std::lock_guard<std::mutex> lock(send_lock_);
+				client_ = INVALID_SOCKET;
+			}
+			closesocket(s);
+			if (!stopping_)
+				PushEvent(Event::kDisconnect);
+		}
+	}
+
+	void StopServer() {
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			stopping_ = true;
+		}
+		wakeup_.notify_all();
+
+		// unblock accept() and recv() on the server thread
+		if (listener_ != INVALID_SOCKET) {
+#ifdef _WIN32
+			shutdown(listener_, SD_BOTH);
+#else
+			shutdown(listener_, SHUT_RDWR);
+#endif
+			closesocket(listener_);
+		}
+		{
+			std::lock_guard<std::mutex> lock(send_lock_);
+			if (client_ != INVALID_SOCKET) {
+#ifdef _WIN32
+				shutdown(client_, SD_BOTH);
+#else
+				shutdown(client_, SHUT_RDWR);
+#endif
+			}
+		}
+		if (thread_.joinable())
+			thread_.join();
+		listener_ = INVALID_SOCKET;
+	}
+
+	Isolate* isolate_;
+	Global<Context> context_;
+	int port_;
+	std::string id_;
+	std::unique_ptr<V8Inspector> inspector_;
+	std::unique_ptr<V8InspectorSession> session_;
+
+	socket_t listener_;
+	socket_t client_;
+	std::thread thread_;
+	std::mutex send_lock_;
+
+	std::mutex lock_;
+	std::condition_variable wakeup_;
+	std::deque<Event> events_;
+	std::atomic<bool> stopping_;
+
+	// only touched on the isolate's thread
+	bool paused_;
+	bool waiting_;
+};
+
+// looked up by isolate so that interrupts queued before Stop find nothing
+static std::mutex agents_lock;
+static std::map<Isolate*, Agent*> agents;
+
+static Agent* FindAgent(Isolate* isolate) {
+	std::lock_guard<std::mutex> lock(agents_lock);
+	auto it = agents.find(isolate);
+	return it == agents.end() ? nullptr : it->second;
+}
+
+void Agent::OnInterrupt(Isolate* isolate, void*) {
+	Agent* agent = FindAgent(isolate);
+	if (agent)
+		agent->DispatchPending();
+}
+
+bool Start(Isolate* isolate, Local<Context> context, int port, bool waitForDebugger) {
+	if (FindAgent(isolate))
+		return false;
+
+#ifdef _WIN32
+	static bool wsa_started = false;
+	if (!wsa_started) {
+		WSADATA wsa;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+			return false;
+		wsa_started = true;
+	}
+#endif
+
+	auto agent = new Agent(isolate, context, port);
+	if (!agent->StartServer()) {
+		delete agent;
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(agents_lock);
+		agents[isolate] = agent;
+	}
+
+	if (waitForDebugger)
+		agent->WaitForDebugger();
+	return true;
+}
+
+void Stop(Isolate* isolate) {
+	Agent* agent;
+	{
+		std::lock_guard<std::mutex> lock(agents_lock);
+		auto it = agents.find(isolate);
+		if (it == agents.end())
+			return;
+		agent = it->second;
+		agents.erase(it);
+	}
+	delete agent;
+}
+
+int Poll(Isolate* isolate) {
+	Agent* agent = FindAgent(isolate);
+	return agent ? agent->DispatchPending() : -1;
+}
+
+} // namespace v8dll_inspector
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+//
+// Optional Chrome DevTools protocol server, compiled in with V8DLL_INSPECTOR.
+//
+// v8_inspector_start listens on 127.0.0.1:<port> for one DevTools client at a
+// time (chrome://inspect, "Configure..." -> 127.0.0.1:<port>). Protocol
+// messages are read on a background thread and dispatched on the isolate's
+// thread: from an interrupt while script is running, from the pause loop while
+// stopped at a breakpoint, and from v8_inspector_poll which the host calls
+// while the engine is idle. Breakpoints, stepping, CPU profiles (Profiler
+// domain) and heap snapshots (HeapProfiler domain) come from V8's own
+// inspector. Nothing is compiled in, and no code runs, without the define.
+//
+// The WebSocket path is a random id chosen on every start and listed by /json,
+// requests must carry Host 127.0.0.1:<port> or localhost:<port>, and upgrades
+// with a web page's Origin are refused, so that pages open in a browser on the
+// same machine cannot attach. Anyone who can reach the port and read /json
+// still can; keep it to development and trusted machines.
+//
+
+#ifdef V8DLL_INSPECTOR
+
+// in v8dll.cpp, which uses it for file names
+std::string Utf16ToUtf8(const uint16_t* s, size_t length);
+
+namespace v8dll_inspector {
+
+// all three must be called on the isolate's thread
+bool Start(v8::Isolate* isolate, v8::Local<v8::Context> context, int port, bool waitForDebugger);
+void Stop(v8::Isolate* isolate);
+int Poll(v8::Isolate* isolate);
+
+} // namespace v8dll_inspector
+
+#endif
@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "v8metrics.h"
+
+#ifdef V8DLL_METRICS
+
+namespace v8dll_metrics {
+
+std::atomic<bool> enabled(false);
+
+static const char* export_names[export_count] = {
+#define V8DLL_EXPORT_NAME(name) #name,
+	V8DLL_EXPORT_LIST(V8DLL_EXPORT_NAME)
+#undef V8DLL_EXPORT_NAME
+};
+
+// blocks of running threads, plus the folded counters of threads that exited
+static std::mutex registry_lock;
+static std::vector<ThreadMetrics*> live_threads;
+static ThreadMetrics* retired_threads;
+static uint64_t thread_count;
+
+static void Accumulate(ThreadMetrics* into, ThreadMetrics* from) {
+	for (int i = 0; i < export_count; i++) {
+		ExportCounters& dst = into->exports[i];
+		ExportCounters& src = from->exports[i];
+		Bump(dst.calls, src.calls.load(std::memory_order_relaxed));
+		Bump(dst.nanoseconds, src.nanoseconds.load(std::memory_order_relaxed));
+		Bump(dst.handles, src.handles.load(std::memory_order_relaxed));
+		Bump(dst.string_bytes, src.string_bytes.load(std::memory_order_relaxed));
+		for (int j = 0; j < kBucketCount; j++)
+			Bump(dst.histogram[j], src.histogram[j].load(std::memory_order_relaxed));
+	}
+}
+
+static void Clear(ThreadMetrics* metrics) {
+	for (int i = 0; i < export_count; i++) {
+		ExportCounters& counters = metrics->exports[i];
+		counters.calls.store(0, std::memory_order_relaxed);
+		counters.nanoseconds.store(0, std::memory_order_relaxed);
+		counters.handles.store(0, std::memory_order_relaxed);
+		counters.string_bytes.store(0, std::memory_order_relaxed);
+		for (int j = 0; j < kBucketCount; j++)
+			counters.histogram[j].store(0, std::memory_order_relaxed);
+	}
+}
+
+class ThreadSlot {
+public:
+	ThreadSlot() : metrics_(nullptr) {}
+
+	~ThreadSlot() {
+		if (!metrics_)
+			return;
+		std::lock_guard<std::mutex> lock(registry_lock);
+		if (!retired_threads)
+			retired_threads = new ThreadMetrics();
+		Accumulate(retired_threads, metrics_);
+		for (size_t i = 0; i < live_threads.size(); i++) {
+			if (live_threads[i] == metrics_) {
+				live_threads.erase(live_threads.begin() + i);
+				break;
+			}
+		}
+		delete metrics_;
+	}
+
+	ThreadMetrics* Get() {
+		if (!metrics_) {
+			metrics_ = new ThreadMetrics();
+			metrics_->current = -1;
+			std::lock_guard<std::mutex> lock(registry_lock);
+			live_threads.push_back(metrics_);
+			thread_count++;
+		}
+		return metrics_;
+	}
+
+private:
+	ThreadMetrics* metrics_;
+};
+
+static thread_local ThreadSlot thread_slot;
+
+ThreadMetrics* CurrentThread() {
+	return thread_slot.Get();
+}
+
+void Reset() {
+	std::lock_guard<std::mutex> lock(registry_lock);
+	for (ThreadMetrics* metrics : live_threads)
+		Clear(metrics);
+	if (retired_threads)
+		Clear(retired_threads);
+}
+
+static uint64_t Percentile(const uint64_t* histogram, uint64_t total, double fraction) {
+	uint64_t rank = (uint64_t)(total * fraction);
+	if (rank >= total)
+		rank = total - 1;
+	uint64_t seen = 0;
+	for (int i = 0; i < kBucketCount; i++) {
+		seen += histogram[i];
+		if (seen > rank)
+			return BucketLowerBound(i);
+	}
+	return BucketLowerBound(kBucketCount - 1);
+}
+
+std::string Snapshot() {
+	ThreadMetrics* total = new ThreadMetrics();
+	uint64_t threads;
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+		for (ThreadMetrics* metrics : live_threads)
+			Accumulate(total, metrics);
+		if (retired_threads)
+			Accumulate(total, retired_threads);
+		threads = thread_count;
+	}
+
+	std::string json;
+	char buf[256];
+	snprintf(buf, sizeof(buf),
+		"{\"enabled\":%s,\"threads\":%llu,\"sub_bucket_bits\":%d,\"exports\":[",
+		enabled.load() ? "true" : "false", (unsigned long long)threads, kSubBucketBits);
+	json += buf;
+
+	uint64_t histogram[kBucketCount];
+	bool first = true;
+	for (int i = 0; i < export_count; i++) {
+		ExportCounters& counters = total->exports[i];
+		uint64_t calls = counters.calls.load(std::memory_order_relaxed);
+		uint64_t handles = counters.handles.load(std::memory_order_relaxed);
+		uint64_t string_bytes = counters.string_bytes.load(std::memory_order_relaxed);
+		if (calls == 0 && handles == 0 && string_bytes == 0)
+			continue;
+
+		uint64_t recorded = 0;
+		int max_bucket = 0;
+		for (int j = 0; j < kBucketCount; j++) {
+			histogram[j] = counters.histogram[j].load(std::memory_order_relaxed);
+			recorded += histogram[j];
+			if (histogram[j])
+				max_bucket = j;
+		}
+
+		snprintf(buf, sizeof(buf),
+			"%s{\"name\":\"%s\",\"calls\":%llu,\"ns\":%llu,\"handles\":%llu,\"string_bytes\":%llu",
+			first ? "" : ",", export_names[i], (unsigned long long)calls,
+			(unsigned long long)counters.nanoseconds.load(std::memory_order_relaxed),
+			(unsigned long long)handles, (unsigned long long)string_bytes);
+		json += buf;
+		first = false;
+
+		if (recorded) {
+			snprintf(buf, sizeof(buf),
+				",\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu",
+				(unsigned long long)Percentile(histogram, recorded, 0.50),
+				(unsigned long long)Percentile(histogram, recorded, 0.90),
+				(unsigned long long)Percentile(histogram, recorded, 0.99),
+				(unsigned long long)BucketLowerBound(max_bucket));
+			json += buf;
+		}
+
+		// sparse histogram: [bucket lower bound in ns, count] pairs
+		json += ",\"histogram\":[";
+		bool first_bucket = true;
+		for (int j = 0; j < kBucketCount; j++) {
+			if (!histogram[j])
+				continue;
+			snprintf(buf, sizeof(buf), "%s[%llu,%llu]", first_bucket ? "" : ",",
+				(unsigned long long)BucketLowerBound(j), (unsigned long long)histogram[j]);
+			json += buf;
+			first_bucket = false;
+		}
+		json += "]}";
+	}
+	json += "]}";
+
+	delete total;
+	return json;
+}
+
+} // namespace v8dll_metrics
+
+#endif
@@ -0,0 +1,235 @@
+#pragma once
+
+//
+// Optional instrumentation of the v8_* exports.
+//
+// Build with V8DLL_METRICS defined to compile it in. Every export opens a
+// V8_EXPORT_SCOPE which, once v8_enable_metrics(TRUE) has been called, counts
+// calls, inclusive wall time, handles created and bytes of strings converted,
+// and records the latency in a log-linear (HDR-style) histogram. Counters live
+// in per-thread blocks written only by their owning thread, so the hot path
+// never takes a lock. When compiled in but disabled the cost of a scope is a
+// single relaxed atomic load; when compiled out the macros expand to nothing.
+//
+
+// every export of v8dll.def, in the same order; keep both lists in sync
+#define V8DLL_EXPORT_LIST(X) \
+	X(v8_init) \
+	X(v8_cleanup) \
+	X(v8_new_isolate) \
+	X(v8_destroy_isolate) \
+	X(v8_enter_isolate) \
+	X(v8_leave_isolate) \
+	X(v8_throw_exception) \
+	X(v8_new_context) \
+	X(v8_enter_context) \
+	X(v8_leave_context) \
+	X(v8_destroy_context) \
+	X(v8_global_object) \
+	X(v8_eval_asstr) \
+	X(v8_destroy_string) \
+	X(v8_strinfo) \
+	X(v8_set_object) \
+	X(v8_register_native_function) \
+	X(v8_FunctionCallbackInfo_data) \
+	X(v8_FunctionCallbackInfo_this) \
+	X(v8_FunctionCallbackInfo_arg_count) \
+	X(v8_FunctionCallbackInfo_internal_field) \
+	X(v8_FunctionCallbackInfo_arg_as_str) \
+	X(v8_FunctionCallbackInfo_arg_as_int32) \
+	X(v8_FunctionCallbackInfo_arg_as_uint32) \
+	X(v8_FunctionCallbackInfo_arg_as_int64) \
+	X(v8_FunctionCallbackInfo_arg_as_float) \
+	X(v8_FunctionCallbackInfo_arg_as_object) \
+	X(v8_FunctionCallbackInfo_return_int32) \
+	X(v8_FunctionCallbackInfo_return_uint32) \
+	X(v8_FunctionCallbackInfo_return_int64) \
+	X(v8_FunctionCallbackInfo_return_float) \
+	X(v8_FunctionCallbackInfo_return_string) \
+	X(v8_new_object_template) \
+	X(v8_destroy_object_template) \
+	X(v8_object_template_add_method) \
+	X(v8_new_object) \
+	X(v8_destroy_object) \
+	X(v8_object_internal_field_count) \
+	X(v8_object_get_internal_field) \
+	X(v8_object_set_internal_field) \
+	X(v8_object_get_int32_field) \
+	X(v8_object_get_uint32_field) \
+	X(v8_object_get_float_field) \
+	X(v8_object_get_int64_field) \
+	X(v8_object_get_string_field) \
+	X(v8_object_get_object_field) \
+	X(v8_enable_metrics) \
+	X(v8_reset_metrics) \
+	X(v8_get_metrics) \
+	X(v8_new_int32_array) \
+	X(v8_new_float_array) \
+	X(v8_new_string_array) \
+	X(v8_new_array_from_values) \
+	X(v8_array_length) \
+	X(v8_array_get_int32) \
+	X(v8_array_get_float) \
+	X(v8_array_get_strings) \
+	X(v8_new_class) \
+	X(v8_destroy_class) \
+	X(v8_class_add_method) \
+	X(v8_class_inherit) \
+	X(v8_class_install) \
+	X(v8_class_new_instance) \
+	X(v8_inspector_start) \
+	X(v8_inspector_stop) \
+	X(v8_inspector_poll) \
+	X(v8_write_heap_snapshot) \
+	X(v8_json_parse) \
+	X(v8_json_stringify) \
+	X(v8_json_write) \
+	X(v8_map_file) \
+	X(v8_new_shared_region) \
+	X(v8_destroy_shared_region) \
+	X(v8_shared_region_data) \
+	X(v8_shared_region_view) \
+	X(v8_new_script_stream) \
+	X(v8_script_stream_feed) \
+	X(v8_script_stream_run) \
+	X(v8_destroy_script_stream)
+
+#ifdef V8DLL_METRICS
+
+namespace v8dll_metrics {
+
+enum ExportId {
+#define V8DLL_EXPORT_ID(name) id_##name,
+	V8DLL_EXPORT_LIST(V8DLL_EXPORT_ID)
+#undef V8DLL_EXPORT_ID
+	export_count
+};
+
+// values below kSubBuckets ns are recorded exactly, every power of two above
+// that is split into kSubBuckets linear buckets (12.5% resolution). Calls
+// slower than 2^kMaxMagnitude ns (~18 minutes) land in the last bucket.
+const int kSubBucketBits = 3;
+const int kSubBuckets = 1 << kSubBucketBits;
+const int kMaxMagnitude = 40;
+const int kBucketCount = (kMaxMagnitude - kSubBucketBits + 2) * kSubBuckets;
+
+struct ExportCounters {
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> nanoseconds;
+	std::atomic<uint64_t> handles;
+	std::atomic<uint64_t> string_bytes;
+	std::atomic<uint64_t> histogram[kBucketCount];
+};
+
+struct ThreadMetrics {
+	ExportCounters exports[export_count];
+	int current;
+};
+
+extern std::atomic<bool> enabled;
+
+ThreadMetrics* CurrentThread();
+
+inline uint64_t Now() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// only the owning thread writes its counters, readers tolerate torn totals
+// across counters but never see a torn 64-bit value
+inline void Bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+	counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+inline int HighestBit(uint64_t v) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, v);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(v);
+#endif
+}
+
+inline int BucketIndex(uint64_t ns) {
+	if (ns < (uint64_t)kSubBuckets)
+		return (int)ns;
+	int magnitude = HighestBit(ns);
+	if (magnitude > kMaxMagnitude)
+		return kBucketCount - 1;
+	int sub = (int)(ns >> (magnitude - kSubBucketBits)) & (kSubBuckets - 1);
+	return (magnitude - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+inline uint64_t BucketLowerBound(int index) {
+	if (index < kSubBuckets)
+		return (uint64_t)index;
+	int magnitude = index / kSubBuckets + kSubBucketBits - 1;
+	uint64_t sub = (uint64_t)(index % kSubBuckets);
+	return (kSubBuckets + sub) << (magnitude - kSubBucketBits);
+}
+
+class ExportScope {
+public:
+	explicit ExportScope(ExportId id) : metrics_(nullptr) {
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		metrics_ = CurrentThread();
+		id_ = id;
+		previous_ = metrics_->current;
+		metrics_->current = id;
+		start_ = Now();
+	}
+
+	~ExportScope() {
+		if (!metrics_)
+			return;
+		uint64_t ns = Now() - start_;
+		ExportCounters& counters = metrics_->exports[id_];
+		Bump(counters.calls, 1);
+		Bump(counters.nanoseconds, ns);
+		Bump(counters.histogram[BucketIndex(ns)], 1);
+		metrics_->current = previous_;
+	}
+
+private:
+	ThreadMetrics* metrics_;
+	ExportId id_;
+	int previous_;
+	uint64_t start_;
+};
+
+// attributes to the innermost export running on this thread, callers check
+// enabled first so the argument is not evaluated while metrics are off
+inline void CountHandles(uint64_t count) {
+	ThreadMetrics* metrics = CurrentThread();
+	if (metrics->current >= 0)
+		Bump(metrics->exports[metrics->current].handles, count);
+}
+
+inline void CountStringBytes(uint64_t bytes) {
+	ThreadMetrics* metrics = CurrentThread();
+	if (metrics->current >= 0)
+		Bump(metrics->exports[metrics->current].string_bytes, bytes);
+}
+
+void Reset();
+
+// JSON snapshot aggregated over all live and exited threads
+std::string Snapshot();
+
+} // namespace v8dll_metrics
+
+#define V8_EXPORT_SCOPE(name) v8dll_metrics::ExportScope v8dll_export_scope_(v8dll_metrics::id_##name)
+#define V8_COUNT_HANDLES(n) \
+	do { if (v8dll_metrics::enabled.load(std::memory_order_relaxed)) v8dll_metrics::CountHandles(n); } while (0)
+#define V8_COUNT_STRING_BYTES(n) \
+	do { if (v8dll_metrics::enabled.load(std::memory_order_relaxed)) v8dll_metrics::CountStringBytes(n); } while (0)
+
+#else
+
+#define V8_EXPORT_SCOPE(name) ((void)0)
+#define V8_COUNT_HANDLES(n) ((void)0)
+#define V8_COUNT_STRING_BYTES(n) ((void)0)
+
+#endif
@@ -31,6 +31,27 @@ const
   V8_SYNTAX_ERROR = 3;
   V8_TYPE_ERROR = 4;
 
+  V8_VALUE_UNDEFINED = 0;
+  V8_VALUE_NULL = 1;
+  V8_VALUE_BOOL = 2;
+  V8_VALUE_INT32 = 3;
+  V8_VALUE_FLOAT = 4;
+  V8_VALUE_STRING = 5;
+  V8_VALUE_OBJECT = 6;
+
+  V8_UTF8 = 0;
+  V8_UTF16 = 1;
+
+  V8_VIEW_BUFFER = 0;
+  V8_VIEW_INT8 = 1;
+  V8_VIEW_UINT8 = 2;
+  V8_VIEW_INT16 = 3;
+  V8_VIEW_UINT16 = 4;
+  V8_VIEW_INT32 = 5;
+  V8_VIEW_UINT32 = 6;
+  V8_VIEW_FLOAT32 = 7;
+  V8_VIEW_FLOAT64 = 8;
+
 type
   PUInt32 = ^UInt32;
   V8FunctionCallbackInfo = type Pointer;
@@ -39,11 +60,52 @@ type
   V8String = type Pointer;
   V8Object = type Pointer;
   V8ObjectTemplate = type Pointer;
+  V8Class = type Pointer;
+  V8SharedRegion = type Pointer;
+  V8ScriptStream = type Pointer;
   V8FunctionCallback = procedure(info: V8FunctionCallbackInfo); cdecl;
+  V8ClassConstructor = function(info: V8FunctionCallbackInfo; data: Pointer): Pointer; cdecl;
+  V8ClassFinalizer = procedure(instance, data: Pointer); cdecl;
+
+  ///
+  ///   a typed element for v8_new_array_from_values, kind is one of V8_VALUE_*
+  ///
+  V8TaggedValue = record
+    kind: Int32;
+    // the C union holds a double and so starts at offset 8 on Win32 and Win64,
+    // a variant record would align every field on its own (see TMessage)
+    _pad: Int32;
+    case Integer of
+      0: (b: LongBool);
+      1: (i: Int32);
+      2: (f: Double);
+      3: (s: PWideChar);
+      4: (o: V8Object);
+  end;
+  PV8TaggedValue = ^V8TaggedValue;
+  PV8String = ^V8String;
+
+  ///
+  ///   host-owned output buffer, grow must reallocate data to at least
+  ///   capacity bytes and update capacity, or return False
+  ///
+  PV8Buffer = ^V8Buffer;
+  V8BufferGrow = function(buffer: PV8Buffer; capacity: Integer): LongBool; cdecl;
+  V8Buffer = record
+    data: PAnsiChar;
+    size: Integer;
+    capacity: Integer;
+    grow: V8BufferGrow;
+    user: Pointer;
+  end;
+  V8WriteCallback = function(data: Pointer; size: Integer; user: Pointer): LongBool; cdecl;
 
   Iv8Object = interface;
   Tv8Object = class;
   Tv8ObjectTemplate = class;
+  Tv8Class = class;
+  Tv8SharedRegion = class;
+  Tv8ScriptStream = class;
 
   Tv8Base = class
   protected
@@ -92,6 +154,74 @@ type
     ///    register a delphi class as an V8 object template
     ///
     function RegisterRttiClass(_ClassType: TClass): Tv8ObjectTemplate;
+
+    ///
+    ///   make a class constructible from javascript as "new Name(...)"
+    ///
+    function InstallClass(cls: Tv8Class): Boolean;
+
+    ///
+    ///   bind a delphi class as a javascript class sharing one prototype,
+    ///   "new ClassName(...)" invokes the best matching delphi constructor.
+    ///   if OwnsInstances, instances are freed when javascript collects them
+    ///
+    function BindRttiClass(_ClassType: TClass; OwnsInstances: Boolean = True): Tv8Class;
+
+    ///
+    ///   create a javascript Array (or an Int32Array if typed) in one call
+    ///
+    function NewInt32Array(const values: array of Int32; typed: Boolean = False): Iv8Object;
+
+    ///
+    ///   create a javascript Array (or a Float64Array if typed) in one call
+    ///
+    function NewFloatArray(const values: array of Double; typed: Boolean = False): Iv8Object;
+
+    ///
+    ///   create a javascript Array of strings in one call
+    ///
+    function NewStringArray(const values: array of UnicodeString): Iv8Object;
+
+    ///
+    ///   create a javascript Array of mixed values in one call
+    ///
+    function NewArray(const values: array of V8TaggedValue): Iv8Object;
+
+    ///
+    ///   serve the DevTools protocol on 127.0.0.1:port (v8dll built with
+    ///   V8DLL_INSPECTOR). if WaitForDebugger, blocks until a client resumes
+    ///
+    function StartInspector(port: Integer; WaitForDebugger: Boolean = False): Boolean;
+    procedure StopInspector;
+
+    ///
+    ///   dispatch pending DevTools messages, call it while no script is running
+    ///
+    function PollInspector: Integer;
+
+    ///
+    ///   write a .heapsnapshot file that DevTools can load
+    ///
+    function WriteHeapSnapshot(const filename: UnicodeString): Boolean;
+
+    ///
+    ///   parse a JSON document without compiling it as script, nil if invalid
+    ///
+    function ParseJson(const json: UnicodeString): Iv8Object;
+    function ParseJsonUtf8(const json: UTF8String): Iv8Object;
+
+    ///
+    ///   expose a shared region to this engine without copying, as a
+    ///   SharedArrayBuffer (V8_VIEW_BUFFER) or a typed array of the given
+    ///   V8_VIEW_* type. offset and length are in bytes, -1 up to the end
+    ///
+    function NewSharedView(region: Tv8SharedRegion; ViewType: Integer = V8_VIEW_BUFFER;
+      offset: Int64 = 0; length: Int64 = -1): Iv8Object;
+
+    ///
+    ///   start compiling a script that arrives in pieces, see Tv8ScriptStream
+    ///
+    function NewScriptStream(const name: UnicodeString = ''; encoding: Integer = V8_UTF16): Tv8ScriptStream;
   end;
 
   ///
@@ -171,6 +301,30 @@ type
     ///   get an object property
     ///
     function GetObject(const name: UnicodeString): Iv8Object;
+
+    ///
+    ///   length of an array, typed array or array-like object, -1 if unknown
+    ///
+    function GetArrayLength: Integer;
+
+    ///
+    ///   read all elements of an array-like object in one call
+    ///
+    function GetInt32Array: TArray<Int32>;
+    function GetFloatArray: TArray<Double>;
+    function GetStringArray: TArray<UnicodeString>;
+
+    ///
+    ///   JSON.stringify the object, empty if it cannot be serialized
+    ///
+    function ToJson(const gap: UnicodeString = ''): UnicodeString;
+
+    ///
+    ///   stream the object as compact UTF-8 JSON, member by member, for
+    ///   documents too large to build as one string. returns the bytes
+    ///   written or -1
+    ///
+    function WriteJson(stream: TStream): Int64;
   end;
 
   Tv8Object = class(TInterfacedObject, Iv8Object)
@@ -190,6 +344,12 @@ type
     function GetInt64(const name: UnicodeString): Int64;
     function GetFloat(const name: UnicodeString): Double;
     function GetObject(const name: UnicodeString): Iv8Object;
+    function GetArrayLength: Integer;
+    function GetInt32Array: TArray<Int32>;
+    function GetFloatArray: TArray<Double>;
+    function GetStringArray: TArray<UnicodeString>;
+    function ToJson(const gap: UnicodeString = ''): UnicodeString;
+    function WriteJson(stream: TStream): Int64;
   end;
 
   ///
@@ -211,6 +371,95 @@ type
     function CreateInstance(FirstInternalField: Pointer): Iv8Object;
   end;
 
+  ///
+  ///   V8 Javascript class (FunctionTemplate), all instances share one prototype.
+  ///   Call AddMethod and Inherit before Tv8Engine.InstallClass or CreateInstance,
+  ///   they fail afterwards. Free the class before its engine; the installed
+  ///   constructor then throws "Illegal constructor" while existing instances
+  ///   are still finalized.
+  ///
+  Tv8Class = class(Tv8Base)
+  public
+    constructor Create(const name: RawByteString; ctor: V8ClassConstructor;
+      finalizer: V8ClassFinalizer; data: Pointer; InternalFieldCount: Integer = 1);
+    destructor Destroy; override;
+
+    ///
+    ///  add a method to the class prototype
+    ///
+    function AddMethod(const name: RawByteString; func: V8FunctionCallback; data: Pointer): Boolean;
+
+    ///
+    ///  inherit the prototype chain of another class
+    ///
+    function Inherit(parent: Tv8Class): Boolean;
+
+    ///
+    ///  create an instance without running the javascript constructor
+    ///
+    function CreateInstance(FirstInternalField: Pointer): Iv8Object;
+  end;
+
+  ///
+  ///   memory shared by every engine of the process, e.g. a large lookup
+  ///   table loaded once and viewed from each engine with NewSharedView.
+  ///   free it only after every engine holding a view has been destroyed
+  ///
+  Tv8SharedRegion = class(Tv8Base)
+  public
+    ///
+    ///  map a file, read-only regions are copy-on-write and never change it,
+    ///  but a store from any engine is seen by every engine of the process
+    ///
+    constructor CreateFromFile(const filename: UnicodeString; writable: Boolean = False);
+
+    ///
+    ///  wrap host memory that outlives the region, or allocate zeroed
+    ///  memory if data is nil
+    ///
+    constructor Create(data: Pointer; size: Int64);
+    destructor Destroy; override;
+
+    ///
+    ///  the shared memory, update it with interlocked operations where
+    ///  scripts use Atomics
+    ///
+    function Data: Pointer;
+    function Size: Int64;
+  end;
+
+  ///
+  ///   a script fed in chunks (from any thread) while v8 parses it on a
+  ///   background thread. Run compiles and executes it in the engine that
+  ///   created the stream, once. Freeing a stream that was not run waits for
+  ///   the background parse of what was fed to finish
+  ///
+  Tv8ScriptStream = class(Tv8Base)
+  private
+    FContext: V8Context;
+    FEncoding: Integer;
+  public
+    constructor Create(engine: Tv8Engine; const name: UnicodeString; encoding: Integer);
+    destructor Destroy; override;
+
+    ///
+    ///  length is in bytes for V8_UTF8 streams and in chars for V8_UTF16
+    ///
+    function Feed(data: Pointer; length: Integer): Boolean; overload;
+
+    ///
+    ///  converted to the stream's encoding if it differs, a converted chunk
+    ///  must not end inside a character
+    ///
+    function Feed(const chunk: UnicodeString): Boolean; overload;
+    function Feed(const chunk: UTF8String): Boolean; overload;
+
+    ///
+    ///  execute the script and cast the return value as string
+    ///
+    function Run: string;
+  end;
+
 ///
 ///   initialize v8 library, should be called before use of any other api
 ///
@@ -294,6 +543,75 @@ function v8_object_get_int64_field(_obj: V8Object; name: PWideChar; value: PInt6
 function v8_object_get_string_field(_obj: V8Object; name: PWideChar): V8String; stdcall;
 function v8_object_get_object_field(_obj: V8Object; name: PWideChar): V8Object; stdcall;
 
+///
+///   export instrumentation, only functional if v8dll was built with V8DLL_METRICS
+///
+function v8_enable_metrics(enable: LongBool): LongBool; stdcall;
+procedure v8_reset_metrics; stdcall;
+function v8_get_metrics(buffer: PAnsiChar; size: Integer): Integer; stdcall;
+
+///
+///   JSON snapshot of the export metrics, empty if they are not compiled in
+///
+function GetV8Metrics: string;
+
+function v8_new_int32_array(isolate: V8Isolate; context: V8Context; data: PInteger;
+  count: Integer; typed: LongBool): V8Object; stdcall;
+
+function v8_new_float_array(isolate: V8Isolate; context: V8Context; data: PDouble;
+  count: Integer; typed: LongBool): V8Object; stdcall;
+
+function v8_new_string_array(isolate: V8Isolate; context: V8Context; data: PPWideChar;
+  count: Integer): V8Object; stdcall;
+
+function v8_new_array_from_values(isolate: V8Isolate; context: V8Context;
+  values: PV8TaggedValue; count: Integer): V8Object; stdcall;
+
+function v8_array_length(obj: V8Object): Integer; stdcall;
+function v8_array_get_int32(obj: V8Object; start: Integer; buffer: PInteger; count: Integer): Integer; stdcall;
+function v8_array_get_float(obj: V8Object; start: Integer; buffer: PDouble; count: Integer): Integer; stdcall;
+function v8_array_get_strings(obj: V8Object; start: Integer; buffer: PV8String; count: Integer): Integer; stdcall;
+
+function v8_new_class(isolate: V8Isolate; name: PAnsiChar; InternalFieldCount: Integer;
+  ctor: V8ClassConstructor; finalizer: V8ClassFinalizer; data: Pointer): V8Class; stdcall;
+
+procedure v8_destroy_class(cls: V8Class); stdcall;
+
+function v8_class_add_method(cls: V8Class; name: PAnsiChar; func: V8FunctionCallback;
+  data: Pointer): LongBool; stdcall;
+
+function v8_class_inherit(cls, parent: V8Class): LongBool; stdcall;
+function v8_class_install(isolate: V8Isolate; context: V8Context; cls: V8Class): LongBool; stdcall;
+
+function v8_class_new_instance(isolate: V8Isolate; context: V8Context; cls: V8Class;
+  FirstInternalField: Pointer): V8Object; stdcall;
+
+///
+///   DevTools inspector, only functional if v8dll was built with V8DLL_INSPECTOR
+///
+function v8_inspector_start(isolate: V8Isolate; context: V8Context; port: Integer;
+  WaitForDebugger: LongBool): LongBool; stdcall;
+procedure v8_inspector_stop(isolate: V8Isolate); stdcall;
+function v8_inspector_poll(isolate: V8Isolate): Integer; stdcall;
+function v8_write_heap_snapshot(isolate: V8Isolate; filename: PWideChar): LongBool; stdcall;
+
+function v8_json_parse(isolate: V8Isolate; context: V8Context; json: Pointer; length: Integer;
+  encoding: Integer): V8Object; stdcall;
+function v8_json_stringify(obj: V8Object; gap: PWideChar; encoding: Integer; buffer: PV8Buffer): Integer; stdcall;
+function v8_json_write(obj: V8Object; encoding: Integer; write: V8WriteCallback; user: Pointer): Int64; stdcall;
+
+function v8_map_file(filename: PWideChar; writable: LongBool): V8SharedRegion; stdcall;
+function v8_new_shared_region(data: Pointer; size: Int64): V8SharedRegion; stdcall;
+procedure v8_destroy_shared_region(region: V8SharedRegion); stdcall;
+function v8_shared_region_data(region: V8SharedRegion; size: PInt64): Pointer; stdcall;
+function v8_shared_region_view(isolate: V8Isolate; context: V8Context; region: V8SharedRegion;
+  offset, length: Int64; ViewType: Integer): V8Object; stdcall;
+
+function v8_new_script_stream(isolate: V8Isolate; encoding: Integer; name: PWideChar): V8ScriptStream; stdcall;
+function v8_script_stream_feed(stream: V8ScriptStream; data: Pointer; length: Integer): LongBool; stdcall;
+function v8_script_stream_run(stream: V8ScriptStream; context: V8Context): V8String; stdcall;
+procedure v8_destroy_script_stream(stream: V8ScriptStream); stdcall;
+
 implementation
 
 function v8_init: LongBool; external 'v8dll.dll';
@@ -374,6 +692,63 @@ begin
   Result := nil;
 end;
 
+function v8_enable_metrics; external 'v8dll.dll';
+procedure v8_reset_metrics; external 'v8dll.dll';
+function v8_get_metrics; external 'v8dll.dll';
+
+function v8_new_int32_array; external 'v8dll.dll';
+function v8_new_float_array; external 'v8dll.dll';
+function v8_new_string_array; external 'v8dll.dll';
+function v8_new_array_from_values; external 'v8dll.dll';
+function v8_array_length; external 'v8dll.dll';
+function v8_array_get_int32; external 'v8dll.dll';
+function v8_array_get_float; external 'v8dll.dll';
+function v8_array_get_strings; external 'v8dll.dll';
+function v8_new_class; external 'v8dll.dll';
+procedure v8_destroy_class; external 'v8dll.dll';
+function v8_class_add_method; external 'v8dll.dll';
+function v8_class_inherit; external 'v8dll.dll';
+function v8_class_install; external 'v8dll.dll';
+function v8_class_new_instance; external 'v8dll.dll';
+function v8_inspector_start; external 'v8dll.dll';
+procedure v8_inspector_stop; external 'v8dll.dll';
+function v8_inspector_poll; external 'v8dll.dll';
+function v8_write_heap_snapshot; external 'v8dll.dll';
+function v8_json_parse; external 'v8dll.dll';
+function v8_json_stringify; external 'v8dll.dll';
+function v8_json_write; external 'v8dll.dll';
+function v8_map_file; external 'v8dll.dll';
+function v8_new_shared_region; external 'v8dll.dll';
+procedure v8_destroy_shared_region; external 'v8dll.dll';
+function v8_shared_region_data; external 'v8dll.dll';
+function v8_shared_region_view; external 'v8dll.dll';
+function v8_new_script_stream; external 'v8dll.dll';
+function v8_script_stream_feed; external 'v8dll.dll';
+function v8_script_stream_run; external 'v8dll.dll';
+procedure v8_destroy_script_stream; external 'v8dll.dll';
+
+function GetV8Metrics: string;
+var
+  json: RawByteString;
+  len: Integer;
+begin
+  len := v8_get_metrics(nil, 0);
+
+  // retry if other threads grew the snapshot between the two calls
+  while len > 0 do
+  begin
+    SetLength(json, len);
+    len := v8_get_metrics(PAnsiChar(json), len + 1);
+    if len <= Length(json) then
+    begin
+      SetLength(json, len);
+      Break;
+    end;
+  end;
+
+  Result := string(json);
+end;
+
 function ConvertInternalString(v8InternalStr: V8String): string;
 var
   s: PWideChar;
@@ -513,6 +888,139 @@ begin
   inherited;
 end;
 
+{ Tv8Class }
+
+function Tv8Class.AddMethod(const name: RawByteString; func: V8FunctionCallback; data: Pointer): Boolean;
+begin
+  Result := v8_class_add_method(FInternalDataPointer, PAnsiChar(name), func, data);
+end;
+
+constructor Tv8Class.Create(const name: RawByteString; ctor: V8ClassConstructor;
+  finalizer: V8ClassFinalizer; data: Pointer; InternalFieldCount: Integer);
+begin
+  inherited Create;
+  FInternalDataPointer := v8_new_class(nil, PAnsiChar(name), InternalFieldCount, ctor, finalizer, data);
+end;
+
+function Tv8Class.CreateInstance(FirstInternalField: Pointer): Iv8Object;
+var
+  obj: V8Object;
+begin
+  obj := v8_class_new_instance(nil, nil, FInternalDataPointer, FirstInternalField);
+
+  if Assigned(obj) then
+    Result := Tv8Object.Create(obj)
+  else
+    Result := nil;
+end;
+
+destructor Tv8Class.Destroy;
+begin
+  v8_destroy_class(FInternalDataPointer);
+  inherited;
+end;
+
+function Tv8Class.Inherit(parent: Tv8Class): Boolean;
+begin
+  Result := v8_class_inherit(FInternalDataPointer, parent.FInternalDataPointer);
+end;
+
+{ Tv8SharedRegion }
+
+constructor Tv8SharedRegion.CreateFromFile(const filename: UnicodeString; writable: Boolean);
+begin
+  inherited Create;
+  FInternalDataPointer := v8_map_file(PWideChar(filename), writable);
+  if not Assigned(FInternalDataPointer) then
+    raise EFOpenError.CreateFmt('cannot map %s', [filename]);
+end;
+
+constructor Tv8SharedRegion.Create(data: Pointer; size: Int64);
+begin
+  inherited Create;
+  FInternalDataPointer := v8_new_shared_region(data, size);
+  if not Assigned(FInternalDataPointer) then
+    raise EOutOfMemory.Create('cannot create shared region');
+end;
+
+destructor Tv8SharedRegion.Destroy;
+begin
+  v8_destroy_shared_region(FInternalDataPointer);
+  inherited;
+end;
+
+function Tv8SharedRegion.Data: Pointer;
+begin
+  Result := v8_shared_region_data(FInternalDataPointer, nil);
+end;
+
+function Tv8SharedRegion.Size: Int64;
+begin
+  if v8_shared_region_data(FInternalDataPointer, @Result) = nil then
+    Result := 0;
+end;
+
+{ Tv8ScriptStream }
+
+constructor Tv8ScriptStream.Create(engine: Tv8Engine; const name: UnicodeString; encoding: Integer);
+begin
+  inherited Create;
+  FContext := engine.FContext;
+  FEncoding := encoding;
+  FInternalDataPointer := v8_new_script_stream(engine.FIsolate, encoding, PWideChar(name));
+end;
+
+destructor Tv8ScriptStream.Destroy;
+begin
+  v8_destroy_script_stream(FInternalDataPointer);
+  inherited;
+end;
+
+function Tv8ScriptStream.Feed(data: Pointer; length: Integer): Boolean;
+begin
+  Result := v8_script_stream_feed(FInternalDataPointer, data, length);
+end;
+
+function Tv8ScriptStream.Feed(const chunk: UnicodeString): Boolean;
+var
+  utf8: UTF8String;
+begin
+  if FEncoding = V8_UTF16 then
+    Result := v8_script_stream_feed(FInternalDataPointer, PWideChar(chunk), System.Length(chunk))
+  else
+  begin
+    utf8 := UTF8Encode(chunk);
+    Result := v8_script_stream_feed(FInternalDataPointer, PAnsiChar(utf8), System.Length(utf8));
+  end;
+end;
+
+function Tv8ScriptStream.Feed(const chunk: UTF8String): Boolean;
+var
+  utf16: UnicodeString;
+begin
+  if FEncoding = V8_UTF16 then
+  begin
+    utf16 := UTF8ToString(chunk);
+    Result := v8_script_stream_feed(FInternalDataPointer, PWideChar(utf16), System.Length(utf16));
+  end
+  else
+    Result := v8_script_stream_feed(FInternalDataPointer, PAnsiChar(chunk), System.Length(chunk));
+end;
+
+function Tv8ScriptStream.Run: string;
+var
+  v8result: V8String;
+begin
+  v8result := v8_script_stream_run(FInternalDataPointer, FContext);
+  if Assigned(v8result) then
+  begin
+    Result := ConvertInternalString(v8result);
+    v8_destroy_string(v8result);
+  end
+  else
+    Result := '';
+end;
+
 { Tv8Object }
 
 constructor Tv8Object.Create(_obj: V8Object);
@@ -594,6 +1102,100 @@ begin
   v8_object_set_internal_field(FInternalObject, idx, value);
 end;
 
+function Tv8Object.GetArrayLength: Integer;
+begin
+  Result := v8_array_length(FInternalObject);
+end;
+
+function Tv8Object.GetInt32Array: TArray<Int32>;
+var
+  len: Integer;
+begin
+  len := v8_array_length(FInternalObject);
+  if len <= 0 then
+    Exit(nil);
+  SetLength(Result, len);
+  len := v8_array_get_int32(FInternalObject, 0, @Result[0], len);
+  if len < 0 then
+    len := 0;
+  SetLength(Result, len);
+end;
+
+function Tv8Object.GetFloatArray: TArray<Double>;
+var
+  len: Integer;
+begin
+  len := v8_array_length(FInternalObject);
+  if len <= 0 then
+    Exit(nil);
+  SetLength(Result, len);
+  len := v8_array_get_float(FInternalObject, 0, @Result[0], len);
+  if len < 0 then
+    len := 0;
+  SetLength(Result, len);
+end;
+
+function Tv8Object.GetStringArray: TArray<UnicodeString>;
+var
+  strs: TArray<V8String>;
+  len, i: Integer;
+begin
+  len := v8_array_length(FInternalObject);
+  if len <= 0 then
+    Exit(nil);
+  SetLength(strs, len);
+  len := v8_array_get_strings(FInternalObject, 0, @strs[0], len);
+  if len < 0 then
+    len := 0;
+  SetLength(Result, len);
+
+  for i := 0 to len - 1 do
+  begin
+    Result[i] := ConvertInternalString(strs[i]);
+    v8_destroy_string(strs[i]);
+  end;
+end;
+
+function GrowStringBuffer(buffer: PV8Buffer; capacity: Integer): LongBool; cdecl;
+var
+  str: PUnicodeString;
+begin
+  str := buffer.user;
+  SetLength(str^, (capacity + 1) div SizeOf(WideChar));
+  buffer.data := PAnsiChar(PWideChar(str^));
+  buffer.capacity := Length(str^) * SizeOf(WideChar);
+  Result := True;
+end;
+
+function Tv8Object.ToJson(const gap: UnicodeString): UnicodeString;
+var
+  buffer: V8Buffer;
+begin
+  Result := '';
+  FillChar(buffer, SizeOf(buffer), 0);
+  buffer.grow := GrowStringBuffer;
+  buffer.user := @Result;
+  if v8_json_stringify(FInternalObject, PWideChar(gap), V8_UTF16, @buffer) < 0 then
+    Result := ''
+  else
+    SetLength(Result, buffer.size div SizeOf(WideChar));
+end;
+
+function WriteToStream(data: Pointer; size: Integer; user: Pointer): LongBool; cdecl;
+begin
+  // exceptions must not unwind through v8dll
+  try
+    Result := TStream(user).Write(data^, size) = size;
+  except
+    Result := False;
+  end;
+end;
+
+function Tv8Object.WriteJson(stream: TStream): Int64;
+begin
+  Result := v8_json_write(FInternalObject, V8_UTF8, WriteToStream, stream);
+end;
+
 procedure Tv8Object.SetObject(const name: UnicodeString; value: Iv8Object);
 begin
   v8_set_object(nil, nil, PWideChar(name), FInternalObject, value.GetInternalObject);
@@ -656,16 +1258,101 @@ begin
 end;
 
 
+function NewArrayResult(obj: V8Object): Iv8Object;
+begin
+  if Assigned(obj) then
+    Result := Tv8Object.Create(obj)
+  else
+    Result := nil;
+end;
+
+function Tv8Engine.NewInt32Array(const values: array of Int32; typed: Boolean): Iv8Object;
+var
+  data: PInteger;
+begin
+  if Length(values) > 0 then
+    data := @values[0]
+  else
+    data := nil;
+  Result := NewArrayResult(v8_new_int32_array(FIsolate, FContext, data, Length(values), typed));
+end;
+
+function Tv8Engine.NewFloatArray(const values: array of Double; typed: Boolean): Iv8Object;
+var
+  data: PDouble;
+begin
+  if Length(values) > 0 then
+    data := @values[0]
+  else
+    data := nil;
+  Result := NewArrayResult(v8_new_float_array(FIsolate, FContext, data, Length(values), typed));
+end;
+
+function Tv8Engine.NewStringArray(const values: array of UnicodeString): Iv8Object;
+var
+  strs: TArray<PWideChar>;
+  i: Integer;
+begin
+  SetLength(strs, Length(values) + 1);
+  for i := 0 to High(values) do
+    strs[i] := PWideChar(values[i]);
+  Result := NewArrayResult(v8_new_string_array(FIsolate, FContext, @strs[0], Length(values)));
+end;
+
+function Tv8Engine.NewArray(const values: array of V8TaggedValue): Iv8Object;
+var
+  data: PV8TaggedValue;
+begin
+  if Length(values) > 0 then
+    data := @values[0]
+  else
+    data := nil;
+  Result := NewArrayResult(v8_new_array_from_values(FIsolate, FContext, data, Length(values)));
+end;
+
+///
+///   convert javascript arguments to the parameters of a delphi method,
+///   throws a javascript exception and returns False if they do not match
+///
+function GetRttiArgs(const info: Tv8FunctionCallbackInfo;
+  const parameters: TArray<TRttiParameter>; out values: TArray<TValue>): Boolean;
+var
+  i, nParams: Integer;
+begin
+  Result := False;
+  nParams := Length(parameters);
+
+  if nParams > info.ArgCount then
+  begin
+    v8_throw_exception(V8_TYPE_ERROR, 'no enough parameters!');
+    Exit;
+  end;
+
+  SetLength(values, nParams);
+
+  for i := 0 to nParams - 1 do
+  begin
+    case parameters[i].ParamType.TypeKind of
+      tkInteger: values[i] := TValue.From(info.args[i].AsInteger);
+      tkFloat: values[i] := TValue.From(info.args[i].AsFloat);
+      tkString, tkLString, tkWString, tkUString, tkVariant: values[i] := TValue.From(info.args[i].AsString);
+      tkInt64: values[i] := TValue.From(info.args[i].AsInt64);
+      else begin
+        v8_throw_exception(V8_TYPE_ERROR, 'parameter type dismatch!');
+        Exit;
+      end;
+    end;
+  end;
+
+  Result := True;
+end;
+
 procedure CallDelphiMethod(_info: V8FunctionCallbackInfo); cdecl;
 var
   info: Tv8FunctionCallbackInfo;
   methods: TArray<TRttiMethod>;
   method: TRttiMethod;
   dobj: TObject;
-  parameters: TArray<TRttiParameter>;
-  parameter: TRttiParameter;
-  ParamType: TRttiType;
-  i, nParams: Integer;
   values: TArray<TValue>;
   ReturnValue: TValue;
   str: string;
@@ -700,32 +1387,8 @@ begin
     Exit;
   end;
 
-  parameters := method.GetParameters;
-  nParams := Length(parameters);
-
-  if nParams > info.ArgCount then
-  begin
-    v8_throw_exception(V8_TYPE_ERROR, 'no enough parameters!');
+  if not GetRttiArgs(info, method.GetParameters, values) then
     Exit;
-  end;
-
-  SetLength(values, nParams);
-
-  for i := 0 to nParams - 1 do
-  begin
-    parameter := parameters[i];
-    ParamType := parameter.ParamType;
-    case ParamType.TypeKind of
-      tkInteger: values[i] := TValue.From(info.args[i].AsInteger);
-      tkFloat: values[i] := TValue.From(info.args[i].AsFloat);
-      tkString, tkLString, tkWString, tkUString, tkVariant: values[i] := TValue.From(info.args[i].AsString);
-      tkInt64: values[i] := TValue.From(info.args[i].AsInt64);
-      else begin
-        v8_throw_exception(V8_TYPE_ERROR, 'parameter type dismatch!');
-        Exit;
-      end;
-    end;
-  end;
 
   ReturnValue := method.Invoke(dobj, values);
 
@@ -763,4 +1426,121 @@ begin
       Result.AddMethod(RawByteString(method.Name), CallDelphiMethod, method.CodeAddress);
 end;
 
+///
+///   V8ClassConstructor for classes bound by BindRttiClass, data is the TClass
+///
+function CreateDelphiInstance(_info: V8FunctionCallbackInfo; data: Pointer): Pointer; cdecl;
+var
+  info: Tv8FunctionCallbackInfo;
+  rttictx: TRttiContext;
+  rttiType: TRttiType;
+  method, ctor: TRttiMethod;
+  values: TArray<TValue>;
+begin
+  Result := nil;
+  info := Tv8FunctionCallbackInfo.Create(_info);
+  rttictx := TRttiContext.Create;
+  rttiType := rttictx.GetType(TClass(data));
+  ctor := nil;
+
+  // the constructor taking the most of the given arguments
+  for method in rttiType.GetMethods do
+    if method.IsConstructor and (Length(method.GetParameters) <= info.ArgCount) and
+      (not Assigned(ctor) or (Length(method.GetParameters) > Length(ctor.GetParameters))) then
+      ctor := method;
+
+  if not Assigned(ctor) then
+  begin
+    v8_throw_exception(V8_TYPE_ERROR, 'no matching constructor!');
+    Exit;
+  end;
+
+  if not GetRttiArgs(info, ctor.GetParameters, values) then
+    Exit;
+
+  try
+    Result := ctor.Invoke(TClass(data), values).AsObject;
+  except
+    on e: Exception do
+      v8_throw_exception(V8_ERROR, PWideChar(e.Message));
+  end;
+end;
+
+procedure FreeDelphiInstance(instance, data: Pointer); cdecl;
+begin
+  TObject(instance).Free;
+end;
+
+function Tv8Engine.InstallClass(cls: Tv8Class): Boolean;
+begin
+  Result := v8_class_install(FIsolate, FContext, cls.GetInternalDataPointer);
+end;
+
+function Tv8Engine.BindRttiClass(_ClassType: TClass; OwnsInstances: Boolean): Tv8Class;
+var
+  rttictx: TRttiContext;
+  rttiType: TRttiType;
+  methods: TArray<TRttiMethod>;
+  method: TRttiMethod;
+  finalizer: V8ClassFinalizer;
+begin
+  if OwnsInstances then
+    finalizer := FreeDelphiInstance
+  else
+    finalizer := nil;
+
+  rttictx := TRttiContext.Create;
+  rttiType := rttictx.GetType(_ClassType);
+  Result := Tv8Class.Create(RawByteString(_ClassType.ClassName), CreateDelphiInstance, finalizer, _ClassType);
+  methods := rttiType.GetDeclaredMethods;
+
+  for method in methods do
+    if method.MethodKind in [mkProcedure, mkFunction, mkOperatorOverload] then
+      Result.AddMethod(RawByteString(method.Name), CallDelphiMethod, method.CodeAddress);
+
+  InstallClass(Result);
+end;
+
+function Tv8Engine.StartInspector(port: Integer; WaitForDebugger: Boolean): Boolean;
+begin
+  Result := v8_inspector_start(FIsolate, FContext, port, WaitForDebugger);
+end;
+
+procedure Tv8Engine.StopInspector;
+begin
+  v8_inspector_stop(FIsolate);
+end;
+
+function Tv8Engine.PollInspector: Integer;
+begin
+  Result := v8_inspector_poll(FIsolate);
+end;
+
+function Tv8Engine.WriteHeapSnapshot(const filename: UnicodeString): Boolean;
+begin
+  Result := v8_write_heap_snapshot(FIsolate, PWideChar(filename));
+end;
+
+function Tv8Engine.ParseJson(const json: UnicodeString): Iv8Object;
+begin
+  Result := NewArrayResult(v8_json_parse(FIsolate, FContext, PWideChar(json), Length(json), V8_UTF16));
+end;
+
+function Tv8Engine.ParseJsonUtf8(const json: UTF8String): Iv8Object;
+begin
+  Result := NewArrayResult(v8_json_parse(FIsolate, FContext, PAnsiChar(json), Length(json), V8_UTF8));
+end;
+
+function Tv8Engine.NewScriptStream(const name: UnicodeString; encoding: Integer): Tv8ScriptStream;
+begin
+  Result := Tv8ScriptStream.Create(Self, name, encoding);
+end;
+
+function Tv8Engine.NewSharedView(region: Tv8SharedRegion; ViewType: Integer;
+  offset, length: Int64): Iv8Object;
+begin
+  Result := NewArrayResult(v8_shared_region_view(FIsolate, FContext, region.GetInternalDataPointer,
+    offset, length, ViewType));
+end;
+
 end.